@@ -0,0 +1,218 @@
+#pragma once
+
+#include <k4a/k4a.h>
+#include <k4arecord/record.h>
+#include <k4arecord/playback.h>
+#include <k4abt.h>
+
+#include "fbxFunctions.h"
+#include "gltfFunctions.h"
+#include "checkerFunctions.h"
+#include "mkvModeFunctions.h"
+#include "profilerFunctions.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <experimental/filesystem>
+
+#define BATCH_DEFAULT_WORKERS 2
+
+//Simple wildcard match supporting * and ?
+bool wildcardMatch(const char* pattern, const char* text) {
+	if (*pattern == '\0') {
+		return *text == '\0';
+	}
+	if (*pattern == '*') {
+		return wildcardMatch(pattern + 1, text) || (*text != '\0' && wildcardMatch(pattern, text + 1));
+	}
+	if (*text != '\0' && (*pattern == '?' || *pattern == *text)) {
+		return wildcardMatch(pattern + 1, text + 1);
+	}
+	return false;
+}
+
+//Expands a directory (every .mkv inside it), a glob like recordings/*.mkv or a single file into a list of inputs
+std::vector<std::string> findBatchInputs(const char* input_pattern) {
+	std::vector<std::string> inputs;
+	std::experimental::filesystem::path inputPath = input_pattern;
+	std::string pattern = "*.mkv";
+	std::experimental::filesystem::path directory = inputPath;
+
+	if (!std::experimental::filesystem::is_directory(inputPath)) {
+		std::string fileName = inputPath.filename().string();
+		if (fileName.find_first_of("*?") == std::string::npos) {
+			if (fileExists(input_pattern)) {
+				inputs.push_back(inputPath.string());
+			}
+			return inputs;
+		}
+		pattern = fileName;
+		directory = inputPath.has_parent_path() ? inputPath.parent_path() : std::experimental::filesystem::current_path();
+		if (!std::experimental::filesystem::is_directory(directory)) {
+			return inputs;
+		}
+	}
+
+	for (auto& entry : std::experimental::filesystem::directory_iterator(directory)) {
+		if (std::experimental::filesystem::is_regular_file(entry.path()) && wildcardMatch(pattern.c_str(), entry.path().filename().string().c_str())) {
+			inputs.push_back(entry.path().string());
+		}
+	}
+	std::sort(inputs.begin(), inputs.end());
+	return inputs;
+}
+
+//Converts one recording with a tracker of its own. A tracker kept from the previous file would carry its temporal
+//smoothing and body IDs into this one, so every file is tracked exactly as -mkv tracks it.
+std::string convertBatchFile(const std::string& input_path, const std::string& output_path,
+	const GltfExportOptions& gltfOptions, FbxManager* fbxManager, std::mutex* fbxMutex, size_t* trackedFrames) {
+	SkeletonTrack track;
+	std::string errorMessage = "";
+
+	//Check output file existence
+	if (fileExists(output_path.c_str())) {
+		return "Output file already exists, please choose another name.\n";
+	}
+
+	//Open the recording
+	k4a_playback_t playback_handle = nullptr;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_open(input_path.c_str(), &playback_handle)) {
+		return "Cannot open recording.\n";
+	}
+	k4a_calibration_t calibration;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(playback_handle, &calibration)) {
+		errorMessage += "Failed to get calibration.\n";
+	}
+
+	//Create body tracker
+	k4abt_tracker_t tracker = NULL;
+	if (errorMessage == "") {
+		k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
+		if (K4A_RESULT_SUCCEEDED != k4abt_tracker_create(&calibration, tracker_config, &tracker)) {
+			errorMessage += "Body tracker initialization failed.\n";
+			tracker = NULL;
+		}
+	}
+
+	//Track the whole recording
+	if (errorMessage == "") {
+		errorMessage += trackRecordingPipelined(playback_handle, tracker, &track, trackedFrames);
+	}
+	if (tracker != NULL) {
+		k4abt_tracker_shutdown(tracker);
+		k4abt_tracker_destroy(tracker);
+	}
+	k4a_playback_close(playback_handle);
+
+	//Create FBX or GLTF from skeleton track, the FBX SDK is shared between workers so exports take turns
+	bool success = true;
+	if (errorMessage == "") {
+		ScopedTimer exportTimer(STAGE_EXPORT);
+		if (outputFBX(output_path)) {
+			std::lock_guard<std::mutex> lock(*fbxMutex);
+			success = createFBX(fbxManager, track, output_path.c_str());
+		}
+		else if (outputGLTF(output_path) || outputGLB(output_path)) {
+			success = createGLTF(track, output_path.c_str(), gltfOptions);
+		}
+		else {
+			errorMessage += "Invalid output type. Use fbx, gltf or glb.\n";
+		}
+	}
+	if (!success) {
+		errorMessage += "An error occurred while creating the output file.\n";
+	}
+
+	return errorMessage;
+}
+
+std::string batchModeFunction(const char* input_pattern, const char* output_format, const ExportOptions& options, int workerCount = BATCH_DEFAULT_WORKERS) {
+	std::string errorMessage = "";
+	std::string format = output_format;
+	if (format.size() > 0 && format[0] == '.') {
+		format = format.substr(1);
+	}
+
+	//Find recordings to convert
+	std::vector<std::string> inputs = findBatchInputs(input_pattern);
+	if (inputs.empty()) {
+		return "No recordings found for batch conversion.\n";
+	}
+	if (workerCount < 1) {
+		workerCount = 1;
+	}
+	if (workerCount > (int)inputs.size()) {
+		workerCount = (int)inputs.size();
+	}
+
+	//Prepare the FBX SDK once for the whole batch
+	FbxManager* fbxManager = NULL;
+	std::mutex fbxMutex;
+	if (format == "fbx") {
+		InitializeSdkManager(fbxManager);
+	}
+
+	//Run a bounded pool of workers that each take the next unconverted file
+	std::vector<std::string> fileErrors(inputs.size());
+	std::vector<size_t> fileFrames(inputs.size(), 0);
+	std::atomic<size_t> nextInput(0);
+	std::mutex printMutex;
+	auto batchStart = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (int w = 0; w < workerCount; w++) {
+		workers.push_back(std::thread([&, w]() {
+			setTraceThreadName("batch worker " + std::to_string(w));
+			for (size_t i = nextInput++; i < inputs.size(); i = nextInput++) {
+				std::experimental::filesystem::path outputPath = inputs[i];
+				outputPath.replace_extension("." + format);
+
+				auto fileStart = std::chrono::steady_clock::now();
+				fileErrors[i] = convertBatchFile(inputs[i], outputPath.string(), options.gltf, fbxManager, &fbxMutex, &fileFrames[i]);
+				std::chrono::duration<double> fileTime = std::chrono::steady_clock::now() - fileStart;
+
+				std::lock_guard<std::mutex> lock(printMutex);
+				std::cout << "[" << i + 1 << "/" << inputs.size() << "] " << inputs[i] << ": ";
+				if (fileErrors[i] == "") {
+					std::cout << fileFrames[i] << " frames in " << fileTime.count() << " s ("
+						<< (fileTime.count() > 0 ? fileFrames[i] / fileTime.count() : 0) << " frames/sec)" << std::endl;
+				}
+				else {
+					std::cout << fileErrors[i];
+				}
+			}
+		}));
+	}
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+
+	if (fbxManager != NULL) {
+		DestroySdkObjects(fbxManager, true);
+	}
+
+	//Report aggregate throughput
+	std::chrono::duration<double> batchTime = std::chrono::steady_clock::now() - batchStart;
+	size_t totalFrames = 0;
+	size_t failedFiles = 0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		totalFrames += fileFrames[i];
+		if (fileErrors[i] != "") {
+			failedFiles++;
+		}
+	}
+	std::cout << "Converted " << inputs.size() - failedFiles << " of " << inputs.size() << " recordings (" << totalFrames << " frames) in "
+		<< batchTime.count() << " s with " << workerCount << " workers ("
+		<< (batchTime.count() > 0 ? totalFrames / batchTime.count() : 0) << " frames/sec)" << std::endl;
+
+	if (failedFiles > 0) {
+		errorMessage += std::to_string(failedFiles) + " recordings failed to convert.\n";
+	}
+	return errorMessage;
+}
@@ -0,0 +1,791 @@
+#pragma once
+
+#include <k4a/k4a.h>
+#include <k4arecord/record.h>
+#include <k4arecord/playback.h>
+#include <k4abt.h>
+
+#include "checkerFunctions.h"
+#include "ringBufferFunctions.h"
+#include "profilerFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <functional>
+
+#define REALTIME_CAPTURE_RING_SIZE 16
+#define REALTIME_CAPTURE_TIMEOUT_MS 1000
+#define REALTIME_TRACKER_TIMEOUT_MS 33
+#define REALTIME_DROP_RING_SIZE 1024
+#define REALTIME_DRAIN_TIMEOUT_MS 5000
+#define PIPELINE_MAX_IN_FLIGHT 3
+#define SYNTHETIC_DEFAULT_FPS 30
+
+//What the tracking loop does when it cannot keep up with the camera
+enum OverloadPolicy {
+	OVERLOAD_BLOCK,			//Wait on the tracker forever, latency grows without bound
+	OVERLOAD_LATEST_FRAME,	//Always track the newest capture and skip any backlog
+	OVERLOAD_DROP_NTH		//While there is a backlog, skip every Nth capture
+};
+
+OverloadPolicy parseOverloadPolicy(const std::string& name) {
+	if (name == "latest") {
+		return OVERLOAD_LATEST_FRAME;
+	}
+	else if (name == "drop") {
+		return OVERLOAD_DROP_NTH;
+	}
+	return OVERLOAD_BLOCK;
+}
+
+uint64_t getCaptureTimestamp(k4a_capture_t capture) {
+	uint64_t timestamp = 0;
+	k4a_image_t depth = k4a_capture_get_depth_image(capture);
+	if (depth != nullptr) {
+		timestamp = k4a_image_get_device_timestamp_usec(depth);
+		k4a_image_release(depth);
+	}
+	return timestamp;
+}
+
+//Source of sensor captures, either a live Kinect or a recording
+class CaptureSource {
+public:
+	virtual ~CaptureSource() {}
+
+	//Returns an error message, empty on success
+	virtual std::string open() = 0;
+	virtual const k4a_calibration_t& calibration() const = 0;
+
+	//Waits up to timeoutMs for the next capture. Finite sources set endOfStream and return K4A_WAIT_RESULT_FAILED when exhausted.
+	virtual k4a_wait_result_t getCapture(k4a_capture_t* capture, int32_t timeoutMs, bool* endOfStream) = 0;
+	virtual void close() = 0;
+};
+
+class DeviceCaptureSource : public CaptureSource {
+public:
+	DeviceCaptureSource(k4a_device_configuration_t deviceConfig) : m_deviceConfig(deviceConfig) {}
+
+	~DeviceCaptureSource() {
+		close();
+	}
+
+	std::string open() override {
+		std::string errorMessage = "";
+		uint32_t kinectCount = k4a_device_get_installed_count();
+		if (kinectCount == 0) { //End program if Kinect isn't found
+			return "Kinect can't be found by program, please try reconnecting.\n";
+		}
+		else if (kinectCount > 1) { //End program if multiple Kinects are found
+			return "Multiple Kinects, detected. Please unplug additional ones.\n";
+		}
+
+		//Connect to the Kinect
+		if (K4A_FAILED(k4a_device_open(K4A_DEVICE_DEFAULT, &m_device))) {
+			m_device = NULL;
+			return "Kinect was found by program, but can't connect. Please try reconnecting.\n";
+		}
+
+		//Initialize the Kinect
+		if (K4A_FAILED(k4a_device_get_calibration(m_device, m_deviceConfig.depth_mode, m_deviceConfig.color_resolution, &m_calibration))) {
+			errorMessage += "Get depth camera calibration failed. \n";
+		}
+
+		//Start recording
+		if (errorMessage == "" && K4A_FAILED(k4a_device_start_cameras(m_device, &m_deviceConfig))) {
+			errorMessage += "Kinect camera failed to start, please try reconnecting.\n";
+		}
+		else if (errorMessage == "") {
+			m_started = true;
+		}
+		return errorMessage;
+	}
+
+	const k4a_calibration_t& calibration() const override {
+		return m_calibration;
+	}
+
+	k4a_wait_result_t getCapture(k4a_capture_t* capture, int32_t timeoutMs, bool* endOfStream) override {
+		*endOfStream = false;
+		ScopedTimer captureTimer(STAGE_CAPTURE);
+		k4a_wait_result_t get_capture_result = k4a_device_get_capture(m_device, capture, timeoutMs);
+		if (get_capture_result != K4A_WAIT_RESULT_SUCCEEDED) {
+			captureTimer.cancel();
+		}
+		return get_capture_result;
+	}
+
+	void close() override {
+		if (m_started) {
+			k4a_device_stop_cameras(m_device);
+			m_started = false;
+		}
+		if (m_device != NULL) {
+			k4a_device_close(m_device);
+			m_device = NULL;
+		}
+	}
+
+private:
+	k4a_device_configuration_t m_deviceConfig;
+	k4a_device_t m_device = NULL;
+	k4a_calibration_t m_calibration;
+	bool m_started = false;
+};
+
+//Plays back a recording. With a speed above zero captures are released on the schedule of their device timestamps
+//scaled by speed, so a recording can stand in for a live Kinect. Otherwise captures are read as fast as possible.
+class PlaybackCaptureSource : public CaptureSource {
+public:
+	PlaybackCaptureSource(const std::string& inputPath, double speed = 0) : m_inputPath(inputPath), m_speed(speed) {}
+
+	~PlaybackCaptureSource() {
+		close();
+	}
+
+	std::string open() override {
+		//Find the mkv file and check that it exists
+		if (K4A_RESULT_SUCCEEDED != k4a_playback_open(m_inputPath.c_str(), &m_playback)) {
+			m_playback = nullptr;
+			return "Cannot open recording.\n";
+		}
+
+		//Calibrate the mkv file to be played back
+		if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(m_playback, &m_calibration)) {
+			return "Failed to get calibration.\n";
+		}
+		m_paceStarted = false;
+		m_maxLagUsec = 0;
+		return "";
+	}
+
+	const k4a_calibration_t& calibration() const override {
+		return m_calibration;
+	}
+
+	k4a_wait_result_t getCapture(k4a_capture_t* capture, int32_t timeoutMs, bool* endOfStream) override {
+		*endOfStream = false;
+
+		//A capture that was not due at the last call is still held
+		if (m_heldCapture == nullptr) {
+			ScopedTimer captureTimer(STAGE_CAPTURE);
+			k4a_stream_result_t stream_result = k4a_playback_get_next_capture(m_playback, &m_heldCapture);
+			if (stream_result != K4A_STREAM_RESULT_SUCCEEDED) {
+				m_heldCapture = nullptr;
+				*endOfStream = stream_result == K4A_STREAM_RESULT_EOF;
+				captureTimer.cancel();
+				return K4A_WAIT_RESULT_FAILED;
+			}
+		}
+
+		//Wait until the capture is due, captures without a depth image are released straight away
+		uint64_t timestamp = m_speed > 0 ? getCaptureTimestamp(m_heldCapture) : 0;
+		if (timestamp != 0) {
+			auto now = std::chrono::steady_clock::now();
+			if (!m_paceStarted) {
+				m_paceStart = now;
+				m_firstTimestamp = timestamp;
+				m_paceStarted = true;
+			}
+			uint64_t offsetUsec = timestamp > m_firstTimestamp ? timestamp - m_firstTimestamp : 0;
+			auto due = m_paceStart + std::chrono::microseconds((int64_t)(offsetUsec / m_speed));
+			if (due > now) {
+				if (timeoutMs != K4A_WAIT_INFINITE && due > now + std::chrono::milliseconds(timeoutMs)) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+					return K4A_WAIT_RESULT_TIMEOUT;
+				}
+				std::this_thread::sleep_until(due);
+			}
+			else {
+				uint64_t lagUsec = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - due).count();
+				if (lagUsec > m_maxLagUsec) {
+					m_maxLagUsec = lagUsec;
+				}
+			}
+		}
+
+		*capture = m_heldCapture;
+		m_heldCapture = nullptr;
+		return K4A_WAIT_RESULT_SUCCEEDED;
+	}
+
+	void close() override {
+		if (m_heldCapture != nullptr) {
+			k4a_capture_release(m_heldCapture);
+			m_heldCapture = nullptr;
+		}
+		if (m_playback != nullptr) {
+			k4a_playback_close(m_playback);
+			m_playback = nullptr;
+		}
+	}
+
+	k4a_playback_t handle() const {
+		return m_playback;
+	}
+
+	//Largest delay past its schedule of any paced capture, grows when the reader cannot keep up
+	uint64_t maxLagUsec() const {
+		return m_maxLagUsec;
+	}
+
+private:
+	std::string m_inputPath;
+	double m_speed;
+	k4a_playback_t m_playback = nullptr;
+	k4a_calibration_t m_calibration;
+	k4a_capture_t m_heldCapture = nullptr;
+	bool m_paceStarted = false;
+	uint64_t m_firstTimestamp = 0;
+	uint64_t m_maxLagUsec = 0;
+	std::chrono::steady_clock::time_point m_paceStart;
+};
+
+enum SkeletonResult {
+	SKELETON_FRAME,		//A tracked skeleton
+	SKELETON_DROPPED,	//A frame was dropped at this timestamp, repeat the previous pose to keep timing
+	SKELETON_PENDING,	//Nothing ready yet, call again
+	SKELETON_END,		//The source is exhausted or was stopped and has drained
+	SKELETON_ERROR		//See errorMessage()
+};
+
+//Source of tracked skeleton frames
+class SkeletonSource {
+public:
+	virtual ~SkeletonSource() {}
+
+	virtual std::string open() = 0;
+	virtual SkeletonResult next(k4abt_skeleton_t* skeleton, uint64_t* timestampUsec) = 0;
+
+	//Asks a live source to stop producing, frames already captured are still returned
+	virtual void stop() = 0;
+
+	//Returns any error that ended the stream
+	virtual std::string close() = 0;
+	virtual std::string errorMessage() const = 0;
+
+	//Calibration the skeletons were tracked with, NULL when there is none. Valid after open().
+	virtual const k4a_calibration_t* calibration() const {
+		return NULL;
+	}
+
+	//The exporters assume 30 frames per second
+	virtual int frameRate() const {
+		return 30;
+	}
+};
+
+//Runs captures through a body tracker. A capture thread fills a lock-free ring and next() does one step of tracking
+//on the caller's thread. If tracking stalls the ring fills up and captures are dropped there instead of overflowing
+//the device queue, except under the block policy where the capture thread waits for space. At most
+//PIPELINE_MAX_IN_FLIGHT captures wait in the tracker at once, like the -mkv pipeline.
+class TrackedSkeletonSource : public SkeletonSource {
+public:
+	TrackedSkeletonSource(CaptureSource* captureSource, OverloadPolicy overloadPolicy = OVERLOAD_BLOCK, int dropEvery = 2, size_t maxFrames = 0)
+		: m_captureSource(captureSource), m_overloadPolicy(overloadPolicy), m_dropEvery(dropEvery), m_maxFrames(maxFrames) {}
+
+	~TrackedSkeletonSource() {
+		close();
+	}
+
+	std::string open() override {
+		m_errorMessage = m_captureSource->open();
+
+		//Create body tracker
+		k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
+		if (m_errorMessage == "" && K4A_FAILED(k4abt_tracker_create(&m_captureSource->calibration(), tracker_config, &m_tracker))) {
+			m_tracker = NULL;
+			m_errorMessage += "Body tracker initialization failed. \n";
+		}
+
+		if (m_errorMessage == "") {
+			m_opened = true;
+			m_capturing = true;
+			m_captureThread = std::thread(&TrackedSkeletonSource::captureLoop, this);
+		}
+		return m_errorMessage;
+	}
+
+	SkeletonResult next(k4abt_skeleton_t* skeleton, uint64_t* timestampUsec) override {
+		if (m_ready.empty() && m_errorMessage == "" && !m_finished) {
+			step();
+		}
+		if (!m_ready.empty()) {
+			ReadyFrame& frame = m_ready.front();
+			SkeletonResult result = frame.result;
+			*timestampUsec = frame.timestampUsec;
+			if (result == SKELETON_FRAME) {
+				*skeleton = frame.skeleton;
+			}
+			m_ready.pop_front();
+			return result;
+		}
+		if (m_errorMessage != "") {
+			return SKELETON_ERROR;
+		}
+		return m_finished ? SKELETON_END : SKELETON_PENDING;
+	}
+
+	void stop() override {
+		m_capturing = false;
+	}
+
+	std::string close() override {
+		if (m_closed) {
+			return m_errorMessage;
+		}
+		m_closed = true;
+
+		//Stop the capture thread and release anything it left in the ring
+		m_capturing = false;
+		if (m_captureThread.joinable()) {
+			m_captureThread.join();
+		}
+		k4a_capture_t leftover_capture;
+		while (m_captureRing.pop(&leftover_capture)) {
+			k4a_capture_release(leftover_capture);
+		}
+		m_errorMessage += m_captureErrorMessage;
+
+		//Release tracker and capture source
+		if (m_tracker != NULL) {
+			k4abt_tracker_shutdown(m_tracker);
+			k4abt_tracker_destroy(m_tracker);
+			m_tracker = NULL;
+		}
+		m_captureSource->close();
+
+		//Report capture queue statistics
+		if (m_opened) {
+			std::cout << "Captured " << m_capturedFrames << " frames, tracked " << m_trackedFrames << ", dropped " << m_droppedFrames + m_untimedDrops
+				<< " (max queue depth " << m_maxQueueDepth << " of " << m_captureRing.capacity() << ")" << std::endl;
+			if (m_untimedDrops > 0) {
+				std::cout << m_untimedDrops << " dropped frames between " << m_firstUntimedDropUsec << " and " << m_lastUntimedDropUsec
+					<< " usec overflowed the drop ring, the output has no repeated poses for them" << std::endl;
+			}
+			if (m_lostResults > 0) {
+				std::cout << m_lostResults << " of the dropped frames were queued in the tracker but never returned" << std::endl;
+			}
+		}
+		return m_errorMessage;
+	}
+
+	std::string errorMessage() const override {
+		return m_errorMessage;
+	}
+
+	const k4a_calibration_t* calibration() const override {
+		return m_opened ? &m_captureSource->calibration() : NULL;
+	}
+
+	size_t trackedFrames() const {
+		return m_trackedFrames;
+	}
+
+private:
+	struct ReadyFrame {
+		SkeletonResult result;
+		uint64_t timestampUsec;
+		k4abt_skeleton_t skeleton;
+	};
+
+	//A capture queued in the tracker whose result has not been popped yet
+	struct PendingCapture {
+		uint64_t enqueueNsec;
+		uint64_t timestampUsec;
+	};
+
+	void captureLoop() {
+		setTraceThreadName("capture");
+		while (m_capturing) {
+			//Stop after maxFrames captures when a limit is set
+			if (m_maxFrames > 0 && m_capturedFrames >= m_maxFrames) {
+				break;
+			}
+
+			//Get current frame
+			k4a_capture_t sensor_capture;
+			bool endOfStream = false;
+			k4a_wait_result_t get_capture_result = m_captureSource->getCapture(&sensor_capture, REALTIME_CAPTURE_TIMEOUT_MS, &endOfStream);
+			if (get_capture_result == K4A_WAIT_RESULT_SUCCEEDED) {
+				if (!check_depth_image_exists(sensor_capture)) {
+					k4a_capture_release(sensor_capture);
+					continue;
+				}
+				m_capturedFrames++;
+				bool queued = m_captureRing.push(sensor_capture);
+				while (!queued && m_overloadPolicy == OVERLOAD_BLOCK && m_capturing) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					queued = m_captureRing.push(sensor_capture);
+				}
+				if (queued) {
+					size_t depth = m_captureRing.size();
+					if (depth > m_maxQueueDepth) {
+						m_maxQueueDepth = depth;
+					}
+				}
+				else {
+					//Drops that do not fit in the drop ring cannot be gap filled, count them and keep their span for the report
+					uint64_t dropTimestamp = getCaptureTimestamp(sensor_capture);
+					if (!m_captureDropRing.push(dropTimestamp)) {
+						if (m_untimedDrops++ == 0) {
+							m_firstUntimedDropUsec = dropTimestamp;
+						}
+						m_lastUntimedDropUsec = dropTimestamp;
+					}
+					k4a_capture_release(sensor_capture);
+				}
+			}
+			else if (endOfStream) {
+				break;
+			}
+			else if (get_capture_result == K4A_WAIT_RESULT_FAILED) {
+				m_captureErrorMessage += "Get depth capture returned error.\n";
+				break;
+			}
+		}
+		m_captureFinished = true;
+	}
+
+	void recordDrop(uint64_t timestamp) {
+		m_pendingDrops.insert(timestamp);
+		m_droppedFrames++;
+	}
+
+	//Hands out every drop that happened before timestamp ahead of the frame at timestamp
+	void releaseDropsBefore(uint64_t timestamp) {
+		while (!m_pendingDrops.empty() && *m_pendingDrops.begin() < timestamp) {
+			ReadyFrame dropped;
+			dropped.result = SKELETON_DROPPED;
+			dropped.timestampUsec = *m_pendingDrops.begin();
+			m_ready.push_back(dropped);
+			m_pendingDrops.erase(m_pendingDrops.begin());
+		}
+	}
+
+	//Results the tracker never returns, found by a later result or by the drain timeout, become drops
+	void recordLostResultsBefore(uint64_t timestamp) {
+		while (!m_pendingCaptures.empty() && m_pendingCaptures.front().timestampUsec < timestamp) {
+			recordDrop(m_pendingCaptures.front().timestampUsec);
+			m_pendingCaptures.pop_front();
+			m_lostResults++;
+		}
+	}
+
+	//One iteration of the tracking loop. Only the block policy waits forever on the tracker, and only while it is full
+	//and captures are still coming, the others use finite timeouts and shed load instead.
+	void step() {
+		int32_t trackerTimeout = m_overloadPolicy == OVERLOAD_BLOCK ? K4A_WAIT_INFINITE : REALTIME_TRACKER_TIMEOUT_MS;
+
+		//Collect drops seen by the capture thread
+		uint64_t capture_drop_timestamp;
+		while (m_captureDropRing.pop(&capture_drop_timestamp)) {
+			recordDrop(capture_drop_timestamp);
+		}
+
+		//Get skeleton from a finished frame. Only a full tracker is waited on with trackerTimeout, before anything
+		//else is queued. Otherwise a waiting capture is queued straight away and an idle loop polls, and once capturing
+		//has finished a result that never comes is given up on instead of waited for forever.
+		if (!m_pendingCaptures.empty()) {
+			k4abt_frame_t body_frame = NULL;
+			bool full = m_pendingCaptures.size() >= PIPELINE_MAX_IN_FLIGHT;
+			bool draining = m_captureFinished && m_captureRing.size() == 0;
+			int32_t popTimeout = REALTIME_TRACKER_TIMEOUT_MS;
+			if (draining) {
+				popTimeout = REALTIME_DRAIN_TIMEOUT_MS;
+			}
+			else if (full) {
+				popTimeout = trackerTimeout;
+			}
+			else if (m_captureRing.size() > 0) {
+				popTimeout = 0;
+			}
+			uint64_t popStart = profileNowNsec();
+			k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(m_tracker, &body_frame, popTimeout);
+			if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED) {
+				uint64_t popEnd = profileNowNsec();
+				recordProfileStage(STAGE_TRACKER_POP, popStart, popEnd);
+				uint64_t frameTimestamp = k4abt_frame_get_device_timestamp_usec(body_frame);
+				recordLostResultsBefore(frameTimestamp);
+				if (!m_pendingCaptures.empty()) {
+					recordProfileStage(STAGE_TRACKER_LATENCY, m_pendingCaptures.front().enqueueNsec, popEnd);
+					m_pendingCaptures.pop_front();
+				}
+				m_trackedFrames++;
+				uint32_t num_bodies = k4abt_frame_get_num_bodies(body_frame);
+				if (num_bodies > 0) {
+					ReadyFrame frame;
+					frame.result = SKELETON_FRAME;
+					frame.timestampUsec = frameTimestamp;
+					k4abt_frame_get_body_skeleton(body_frame, 0, &frame.skeleton);
+					releaseDropsBefore(frame.timestampUsec);
+					m_ready.push_back(frame);
+				}
+				k4abt_frame_release(body_frame);
+				return;
+			}
+			else if (pop_frame_result == K4A_WAIT_RESULT_FAILED) {
+				m_errorMessage += "Pop body frame result failed.\n";
+				return;
+			}
+			else if (draining) {
+				recordLostResultsBefore(m_pendingCaptures.front().timestampUsec + 1);
+				return;
+			}
+			else if (full) {
+				return;
+			}
+			//On a timeout fall through and queue the next capture so the tracker is never idle
+		}
+
+		//Get next captured frame, latest-frame-wins skips straight to the newest one
+		k4a_capture_t sensor_capture;
+		if (!m_captureRing.pop(&sensor_capture)) {
+			if (m_captureFinished && m_captureRing.size() == 0 && m_pendingCaptures.empty()) {
+				//Flush remaining drops so callers can pad the end of the recording
+				while (m_captureDropRing.pop(&capture_drop_timestamp)) {
+					recordDrop(capture_drop_timestamp);
+				}
+				releaseDropsBefore(UINT64_MAX);
+				m_finished = true;
+			}
+			else if (m_pendingCaptures.empty()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return;
+		}
+		if (m_overloadPolicy == OVERLOAD_LATEST_FRAME) {
+			k4a_capture_t newer_capture;
+			while (m_captureRing.pop(&newer_capture)) {
+				recordDrop(getCaptureTimestamp(sensor_capture));
+				k4a_capture_release(sensor_capture);
+				sensor_capture = newer_capture;
+			}
+		}
+		else if (m_overloadPolicy == OVERLOAD_DROP_NTH && m_captureRing.size() > 0) {
+			//Only shed while there is a backlog
+			m_consideredFrames++;
+			if (m_dropEvery > 0 && m_consideredFrames % m_dropEvery == 0) {
+				recordDrop(getCaptureTimestamp(sensor_capture));
+				k4a_capture_release(sensor_capture);
+				return;
+			}
+		}
+
+		//Process current frame
+		uint64_t captureTimestamp = getCaptureTimestamp(sensor_capture);
+		uint64_t enqueueStart = profileNowNsec();
+		k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(m_tracker, sensor_capture, trackerTimeout);
+		k4a_capture_release(sensor_capture);
+		if (queue_capture_result == K4A_WAIT_RESULT_SUCCEEDED) {
+			recordProfileStage(STAGE_TRACKER_ENQUEUE, enqueueStart, profileNowNsec());
+			PendingCapture pending;
+			pending.enqueueNsec = enqueueStart;
+			pending.timestampUsec = captureTimestamp;
+			m_pendingCaptures.push_back(pending);
+		}
+		else if (queue_capture_result == K4A_WAIT_RESULT_TIMEOUT) {
+			recordDrop(captureTimestamp);
+		}
+		else {
+			m_errorMessage += ("Add capture to tracker process queue failed.\n");
+		}
+	}
+
+	CaptureSource* m_captureSource;
+	OverloadPolicy m_overloadPolicy;
+	int m_dropEvery;
+	size_t m_maxFrames;
+	k4abt_tracker_t m_tracker = NULL;
+
+	//Shared with the capture thread
+	SpscRing<k4a_capture_t, REALTIME_CAPTURE_RING_SIZE> m_captureRing;
+	SpscRing<uint64_t, REALTIME_DROP_RING_SIZE> m_captureDropRing;
+	std::thread m_captureThread;
+	std::atomic<bool> m_capturing{ false };
+	std::atomic<bool> m_captureFinished{ false };
+	std::atomic<size_t> m_capturedFrames{ 0 };
+	std::atomic<size_t> m_maxQueueDepth{ 0 };
+	std::atomic<size_t> m_untimedDrops{ 0 };
+	std::atomic<uint64_t> m_firstUntimedDropUsec{ 0 };
+	std::atomic<uint64_t> m_lastUntimedDropUsec{ 0 };
+	std::string m_captureErrorMessage = "";
+
+	//Only used on the tracking thread
+	std::deque<ReadyFrame> m_ready;
+	std::set<uint64_t> m_pendingDrops;
+	std::deque<PendingCapture> m_pendingCaptures;
+	size_t m_lostResults = 0;
+	size_t m_consideredFrames = 0;
+	size_t m_trackedFrames = 0;
+	size_t m_droppedFrames = 0;
+	bool m_finished = false;
+	bool m_opened = false;
+	bool m_closed = false;
+	std::string m_errorMessage = "";
+};
+
+//Rest pose in millimetres in Kinect camera space (y down, z away from the sensor), in joint order
+const float syntheticRestPose[27][3] = {
+	{ 0, 0, 2000 }, { 0, -200, 2000 }, { 0, -380, 2000 }, { 0, -560, 2000 },				//Pelvis, spine navel, spine chest, neck
+	{ -40, -520, 2000 }, { -180, -500, 2000 }, { -200, -250, 2000 }, { -210, -20, 2000 },	//Left clavicle, shoulder, elbow, wrist
+	{ -215, 60, 2000 }, { -220, 140, 2000 }, { -190, 80, 1970 },							//Left hand, handtip, thumb
+	{ 40, -520, 2000 }, { 180, -500, 2000 }, { 200, -250, 2000 }, { 210, -20, 2000 },		//Right clavicle, shoulder, elbow, wrist
+	{ 215, 60, 2000 }, { 220, 140, 2000 }, { 190, 80, 1970 },								//Right hand, handtip, thumb
+	{ -90, 0, 2000 }, { -95, 420, 2000 }, { -100, 820, 2000 }, { -100, 860, 1880 },			//Left hip, knee, ankle, foot
+	{ 90, 0, 2000 }, { 95, 420, 2000 }, { 100, 820, 2000 }, { 100, 860, 1880 },				//Right hip, knee, ankle, foot
+	{ 0, -700, 1980 }																		//Head
+};
+
+//Fills skeleton with the deterministic synthetic pose at frameIndex
+void createSyntheticSkeleton(size_t frameIndex, int fps, k4abt_skeleton_t* skeleton) {
+	double t = (double)frameIndex / fps;
+	float sway = (float)(300.0 * std::sin(t * 0.5));
+	float swing = (float)(150.0 * std::sin(t * 2.0));
+
+	*skeleton = k4abt_skeleton_t();
+	for (int i = 0; i < 27; i++) {
+		float x = syntheticRestPose[i][0] + sway;
+		float y = syntheticRestPose[i][1];
+		float z = syntheticRestPose[i][2];
+
+		//Swing the arms from the elbow down in opposite directions and bend the knees a little
+		float pitch = 0;
+		if (i >= 6 && i <= 10) {
+			z += swing * (i - 5) / 5.0f;
+			pitch = swing * 0.004f;
+		}
+		else if (i >= 13 && i <= 17) {
+			z -= swing * (i - 12) / 5.0f;
+			pitch = -swing * 0.004f;
+		}
+		else if (i == 19 || i == 23) {
+			z -= std::fabs(swing) * 0.3f;
+		}
+
+		//Turn the whole body a little with the sway and pitch the swinging joints, yaw about y then pitch about x
+		float halfYaw = sway * 0.0005f;
+		float halfPitch = pitch * 0.5f;
+		skeleton->joints[i].position.xyz.x = x;
+		skeleton->joints[i].position.xyz.y = y;
+		skeleton->joints[i].position.xyz.z = z;
+		skeleton->joints[i].orientation.wxyz.w = std::cos(halfYaw) * std::cos(halfPitch);
+		skeleton->joints[i].orientation.wxyz.x = std::cos(halfYaw) * std::sin(halfPitch);
+		skeleton->joints[i].orientation.wxyz.y = std::sin(halfYaw) * std::cos(halfPitch);
+		skeleton->joints[i].orientation.wxyz.z = -std::sin(halfYaw) * std::sin(halfPitch);
+		skeleton->joints[i].confidence_level = K4ABT_JOINT_CONFIDENCE_MEDIUM;
+	}
+}
+
+//Fills track with frameCount synthetic frames timestamped at fps, for benchmarks that need a session in memory
+void createSyntheticTrack(size_t frameCount, int fps, SkeletonTrack* track) {
+	track->reserve(track->size() + frameCount);
+	k4abt_skeleton_t skeleton;
+	for (size_t i = 0; i < frameCount; i++) {
+		createSyntheticSkeleton(i, fps, &skeleton);
+		track->append(skeleton, (uint64_t)i * 1000000 / fps);
+	}
+}
+
+//Emits deterministic skeleton frames without any sensor or tracker so the pipeline can be profiled anywhere.
+//Paced sources release frames at fps in real time, unpaced ones as fast as they are asked for.
+class SyntheticSkeletonSource : public SkeletonSource {
+public:
+	SyntheticSkeletonSource(size_t frameCount, int fps = SYNTHETIC_DEFAULT_FPS, bool paced = true)
+		: m_frameCount(frameCount), m_fps(fps > 0 ? fps : SYNTHETIC_DEFAULT_FPS), m_paced(paced) {}
+
+	std::string open() override {
+		m_start = std::chrono::steady_clock::now();
+		return "";
+	}
+
+	SkeletonResult next(k4abt_skeleton_t* skeleton, uint64_t* timestampUsec) override {
+		if (m_stopped || m_frameIndex >= m_frameCount) {
+			return SKELETON_END;
+		}
+		uint64_t frameUsec = (uint64_t)m_frameIndex * 1000000 / m_fps;
+		if (m_paced) {
+			auto due = m_start + std::chrono::microseconds(frameUsec);
+			if (std::chrono::steady_clock::now() < due) {
+				std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(5)));
+				return SKELETON_PENDING;
+			}
+		}
+		createSyntheticSkeleton(m_frameIndex, m_fps, skeleton);
+		*timestampUsec = frameUsec;
+		m_frameIndex++;
+		return SKELETON_FRAME;
+	}
+
+	void stop() override {
+		m_stopped = true;
+	}
+
+	std::string close() override {
+		return "";
+	}
+
+	std::string errorMessage() const override {
+		return "";
+	}
+
+	int frameRate() const override {
+		return m_fps;
+	}
+
+private:
+	size_t m_frameCount;
+	int m_fps;
+	bool m_paced;
+	size_t m_frameIndex = 0;
+	bool m_stopped = false;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+//Pulls every frame out of an opened source and hands skeletons and their timestamps to store. Dropped frames repeat the previous pose
+//so exporters that assume a fixed frame rate keep correct timing, and their timestamps are added to droppedTimestamps.
+//shouldStop is polled between frames, once it returns true the source is stopped and drained.
+std::string collectSkeletons(SkeletonSource* source, std::function<bool()> shouldStop,
+	std::function<void(const k4abt_skeleton_t&, uint64_t)> store, std::vector<uint64_t>* droppedTimestamps) {
+	bool havePreviousSkeleton = false;
+	bool stopRequested = false;
+	k4abt_skeleton_t previousSkeleton;
+
+	while (true) {
+		if (!stopRequested && shouldStop && shouldStop()) {
+			source->stop();
+			stopRequested = true;
+		}
+
+		k4abt_skeleton_t skeleton;
+		uint64_t timestamp = 0;
+		SkeletonResult result = source->next(&skeleton, &timestamp);
+		if (result == SKELETON_FRAME) {
+			store(skeleton, timestamp);
+			previousSkeleton = skeleton;
+			havePreviousSkeleton = true;
+		}
+		else if (result == SKELETON_DROPPED) {
+			if (havePreviousSkeleton) {
+				store(previousSkeleton, timestamp);
+			}
+			if (droppedTimestamps != NULL) {
+				droppedTimestamps->push_back(timestamp);
+			}
+		}
+		else if (result == SKELETON_END) {
+			return "";
+		}
+		else if (result == SKELETON_ERROR) {
+			return source->errorMessage();
+		}
+	}
+}
@@ -5,8 +5,15 @@
 #include <k4arecord/playback.h>
 #include <k4abt.h>
 
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <cstdlib>
+#include <experimental/filesystem>
 
 bool check_depth_image_exists(k4a_capture_t capture)
 {
@@ -29,6 +36,12 @@ bool fileExists(const char* output_path) {
 	return result;
 }
 
+//Compares the last extension of a path, so relative paths such as ./take.skel and names with several dots such
+//as the <output>.journal.skel journals are recognised. Input paths are checked with this.
+bool hasExtension(std::string path, const char* extension) {
+	return std::experimental::filesystem::path(path).extension() == extension;
+}
+
 bool outputFBX(std::string outputPath) {
 	std::stringstream fullFileName(outputPath);
 	std::string fileName, fileExtension;
@@ -49,4 +62,70 @@ bool outputGLTF(std::string outputPath) {
 		return true;
 	}
 	return false;
+}
+
+bool outputGLB(std::string outputPath) {
+	return hasExtension(outputPath, ".glb");
+}
+
+bool outputSKEL(std::string outputPath) {
+	return hasExtension(outputPath, ".skel");
+}
+
+bool outputSKELZ(std::string outputPath) {
+	return hasExtension(outputPath, ".skelz");
+}
+
+bool hasFlag(int argc, char** argv, const char* flag) {
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == flag) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int getFlagValue(int argc, char** argv, const char* flag, int defaultValue) {
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == flag) {
+			return std::atoi(argv[i + 1]);
+		}
+	}
+	return defaultValue;
+}
+
+double getFlagDouble(int argc, char** argv, const char* flag, double defaultValue) {
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == flag) {
+			return std::atof(argv[i + 1]);
+		}
+	}
+	return defaultValue;
+}
+
+std::string getFlagString(int argc, char** argv, const char* flag, const char* defaultValue) {
+	for (int i = 1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == flag) {
+			return argv[i + 1];
+		}
+	}
+	return defaultValue;
+}
+
+//Creates the directory an output file will be written to
+void createOutputDirectory(const char* output_path) {
+	std::experimental::filesystem::path path = output_path;
+	if (path.has_parent_path()) {
+		std::error_code error;
+		std::experimental::filesystem::create_directories(path.parent_path(), error);
+	}
+}
+
+//Press spacebar to stop recording, only available on Windows
+bool stopKeyPressed() {
+#ifdef _WIN32
+	return GetAsyncKeyState(VK_SPACE) != 0;
+#else
+	return false;
+#endif
 }
\ No newline at end of file
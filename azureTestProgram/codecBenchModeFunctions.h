@@ -0,0 +1,100 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "checkerFunctions.h"
+#include "profilerFunctions.h"
+#include "captureSourceFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonCodecFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#define CODEC_BENCH_DEFAULT_FRAMES 18000
+
+//Measures encode and decode throughput and the compression ratio of the skeleton codec on a .skel or .skelz
+//file, or on generated skeletons when input_path is NULL, and checks every decoded frame against the original
+std::string codecBenchModeFunction(const char* input_path, const SkeletonCodecSettings& settings, int frameCount = CODEC_BENCH_DEFAULT_FRAMES) {
+	std::string settingsError = checkSkeletonCodecSettings(settings);
+	if (settingsError != "") {
+		return settingsError;
+	}
+
+	//Load or generate the track
+	SkeletonTrack track;
+	if (input_path != NULL && outputSKELZ(input_path)) {
+		std::string errorMessage = readSkelzFile(input_path, &track);
+		if (errorMessage != "") {
+			return errorMessage;
+		}
+	}
+	else if (input_path != NULL) {
+		SkelFileReader reader;
+		std::string errorMessage = reader.open(input_path);
+		if (errorMessage != "") {
+			return errorMessage;
+		}
+		reader.readAll(&track);
+	}
+	else {
+		createSyntheticTrack((size_t)std::max(frameCount, 0), SYNTHETIC_DEFAULT_FPS, &track);
+	}
+	if (track.empty()) {
+		return "No frames to benchmark.\n";
+	}
+
+	std::vector<uint8_t> encoded;
+	double encodeSeconds = timeBenchmarkPasses([&]() {
+		encodeSkeletonTrack(track, settings, &encoded);
+	});
+
+	SkeletonTrack decoded;
+	std::string decodeError = "";
+	double decodeSeconds = timeBenchmarkPasses([&]() {
+		decoded.clear();
+		decodeError = decodeSkeletonTrack(encoded.data(), encoded.size(), &decoded);
+	});
+	if (decodeError != "") {
+		return decodeError;
+	}
+
+	//Round trip check: timestamps and confidence are lossless, positions and orientations within the error the
+	//settings allow
+	if (decoded.size() != track.size()) {
+		return "Decoded frame count does not match.\n";
+	}
+	for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+		if (track.confidence(joint) != decoded.confidence(joint)) {
+			return "Decoded confidence does not match.\n";
+		}
+	}
+	if (track.timestamps() != decoded.timestamps()) {
+		return "Decoded timestamps do not match.\n";
+	}
+	double maxPositionError, maxOrientationError;
+	measureSkeletonCodecError(track, decoded, &maxPositionError, &maxOrientationError);
+	if (maxPositionError > skeletonCodecPositionTolerance(settings)) {
+		return "Decoded positions exceed the codec precision.\n";
+	}
+	if (maxOrientationError > skeletonCodecOrientationTolerance(settings)) {
+		return "Decoded orientations exceed the codec precision.\n";
+	}
+
+	size_t rawBytes = track.size() * sizeof(k4abt_skeleton_t);
+	size_t skelBytes = track.size() * sizeof(SkelFrameRecord);
+	std::cout << "Frames: " << track.size() << (input_path != NULL ? "" : " (synthetic)") << std::endl;
+	std::cout << "Precision: " << settings.positionPrecisionMm << " mm, " << settings.orientationBits << " bit orientations" << std::endl;
+	std::cout << "Encoded: " << encoded.size() << " bytes, " << (double)encoded.size() / track.size() << " bytes/frame" << std::endl;
+	std::cout << "Compression ratio: " << (double)rawBytes / encoded.size() << "x vs k4abt_skeleton_t, "
+		<< (double)skelBytes / encoded.size() << "x vs .skel records" << std::endl;
+	std::cout << "Encode: " << track.size() / encodeSeconds << " frames/sec, " << skelBytes / encodeSeconds / 1e6 << " MB/s of .skel records" << std::endl;
+	std::cout << "Decode: " << track.size() / decodeSeconds << " frames/sec, " << skelBytes / decodeSeconds / 1e6 << " MB/s of .skel records" << std::endl;
+	std::cout << "Max error: " << maxPositionError << " mm, " << maxOrientationError << " degrees" << std::endl;
+	return "";
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "fbxFunctions.h"
+#include "gltfFunctions.h"
+#include "checkerFunctions.h"
+#include "profilerFunctions.h"
+#include "skeletonTrackFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonCodecFunctions.h"
+
+#include <string>
+#include <vector>
+
+//Options for every file the program writes, read from the command line once and passed down to the exporters
+struct ExportOptions {
+	GltfExportOptions gltf;
+	//Position step and orientation bits of SKELZ outputs, which are refused if they do not hold them
+	SkeletonCodecSettings skelz;
+};
+
+//Creates the output directory and writes the track as FBX, GLTF, GLB, SKEL or compressed SKELZ depending on the output extension.
+//calibration is only stored in SKEL files and may be NULL.
+std::string exportSkeletons(const SkeletonTrack& track, const char* output_path, const ExportOptions& options, const k4a_calibration_t* calibration = NULL) {
+	std::string errorMessage = "";
+
+	//Create output path
+	createOutputDirectory(output_path);
+
+	//Create FBX or GLTF from skeleton track
+	ScopedTimer exportTimer(STAGE_EXPORT);
+	bool success = true;
+	if (outputFBX(output_path)) {
+		success = createFBX(track, output_path);
+	}
+	else if (outputGLTF(output_path) || outputGLB(output_path)) {
+		success = createGLTF(track, output_path, options.gltf);
+	}
+	else if (outputSKEL(output_path)) {
+		success = writeSkelFile(track, output_path, calibration);
+	}
+	else if (outputSKELZ(output_path)) {
+		errorMessage += writeSkelzFile(track, output_path, options.skelz);
+	}
+	else {
+		errorMessage += "Invalid output type. Use fbx, gltf, glb, skel or skelz.\n";
+	}
+	if (!success) {
+		if (outputFBX(output_path)) {
+			errorMessage += "An error occurred while creating the fbx.\n";
+		}
+		else if (outputGLTF(output_path) || outputGLB(output_path)) {
+			errorMessage += "An error occurred while creating the gltf.\n";
+		}
+		else if (outputSKEL(output_path)) {
+			errorMessage += "An error occurred while creating the skel.\n";
+		}
+	}
+
+	return errorMessage;
+}
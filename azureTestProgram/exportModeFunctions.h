@@ -0,0 +1,77 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "exportFunctions.h"
+#include "checkerFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonCodecFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <iostream>
+
+//Re-exports a recorded .skel or .skelz file without running the body tracker again. fromSeconds and toSeconds select
+//a time range relative to the first frame, a negative toSeconds exports to the end.
+std::string exportModeFunction(const char* input_path, const char* output_path, const ExportOptions& options, double fromSeconds = 0, double toSeconds = -1) {
+	std::string errorMessage = "";
+
+	//Check output file existence
+	if (fileExists(output_path)) {
+		return "Output file already exists, please choose another name.\n";
+	}
+
+	uint64_t fromUsec = (uint64_t)(fromSeconds > 0 ? fromSeconds * 1000000 : 0);
+	uint64_t toUsec = toSeconds < 0 ? UINT64_MAX : (uint64_t)(toSeconds * 1000000);
+	SkeletonTrack track;
+	SkelFileReader reader;
+	const k4a_calibration_t* calibration = NULL;
+	if (outputSKELZ(input_path)) {
+		//Compressed files are decoded whole, then the time range is cut from the decoded track
+		SkeletonTrack decoded;
+		errorMessage += readSkelzFile(input_path, &decoded);
+		if (errorMessage == "" && decoded.empty()) {
+			errorMessage += "Skeleton file has no frames.\n";
+		}
+		if (errorMessage == "") {
+			uint64_t firstUsec = decoded.timestamps()[0];
+			for (size_t i = 0; i < decoded.size(); i++) {
+				uint64_t offsetUsec = decoded.timestamps()[i] - firstUsec;
+				if (offsetUsec >= fromUsec && offsetUsec < toUsec) {
+					track.append(decoded.skeleton(i), decoded.timestamps()[i]);
+				}
+			}
+			if (!track.empty()) {
+				std::cout << "Read " << track.size() << " of " << decoded.size() << " frames" << std::endl;
+			}
+		}
+	}
+	else {
+		//Map the skeleton file
+		errorMessage += reader.open(input_path);
+		if (errorMessage == "" && reader.frameCount() == 0) {
+			errorMessage += "Skeleton file has no frames.\n";
+		}
+
+		//Read the requested time range, found by binary search on the timestamps
+		if (errorMessage == "") {
+			uint64_t firstUsec = reader.timestampAt(0);
+			reader.readRange(firstUsec + fromUsec, toUsec == UINT64_MAX ? UINT64_MAX : firstUsec + toUsec, &track);
+			if (!track.empty()) {
+				std::cout << "Read " << track.size() << " of " << reader.frameCount() << " frames"
+					<< (reader.indexed() ? "" : " (no index, the recording was not closed)") << std::endl;
+			}
+			calibration = reader.calibration();
+		}
+	}
+	if (errorMessage == "" && track.empty()) {
+		errorMessage += "No frames in the requested time range.\n";
+	}
+
+	//Create FBX, GLTF or SKEL from skeleton track
+	if (errorMessage == "") {
+		errorMessage += exportSkeletons(track, output_path, options, calibration);
+	}
+
+	return errorMessage;
+}
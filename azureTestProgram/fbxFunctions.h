@@ -2,9 +2,13 @@
 
 #include <fbxsdk.h>
 
+#include "skeletonTrackFunctions.h"
+
 #include <vector>
 #include <iostream>
 #include <string>
+#include <cmath>
+#include <algorithm>
 #include <experimental/filesystem>
 
 #ifdef IOS_REF
@@ -12,7 +16,7 @@
 	#define IOS_REF (*(pManager->GetIOSettings()))
 #endif
 
-void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
+void InitializeSdkManager(FbxManager*& pManager)
 {
 	//The first thing to do is to create the FBX Manager which is the object allocator for almost all the classes in the SDK
 	pManager = FbxManager::Create();
@@ -30,6 +34,11 @@ void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
 	//Load plugins from the executable directory (optional)
 	FbxString lPath = FbxGetApplicationDirectory();
 	pManager->LoadPluginsDirectory(lPath.Buffer());
+}
+
+void InitializeSdkObjects(FbxManager*& pManager, FbxScene*& pScene)
+{
+	InitializeSdkManager(pManager);
 
 	//Create an FBX scene. This object holds most objects imported/exported from/to files.
 	pScene = FbxScene::Create(pManager, "My Scene");
@@ -113,87 +122,13 @@ void createNodes(FbxScene* pScene, std::vector<FbxNode*> *nodes) {
 	FbxNode* pSkeleton = FbxNode::Create(pScene, "Skeleton");
 	lRootNode->AddChild(pSkeleton);
 
-	FbxNode* pNodePelvis = FbxNode::Create(pScene, "Pelvis");
-	pSkeleton->AddChild(pNodePelvis);
-	nodes->push_back(pNodePelvis);
-	FbxNode* pNodeSpineNaval = FbxNode::Create(pScene, "Spine_Naval");
-	pNodePelvis->AddChild(pNodeSpineNaval);
-	nodes->push_back(pNodeSpineNaval);
-	FbxNode* pNodeSpineChest = FbxNode::Create(pScene, "Spine_Chest");
-	pNodeSpineNaval->AddChild(pNodeSpineChest);
-	nodes->push_back(pNodeSpineChest);
-	FbxNode* pNodeNeck = FbxNode::Create(pScene, "Neck");
-	pNodeSpineChest->AddChild(pNodeNeck);
-	nodes->push_back(pNodeNeck);
-	FbxNode* pNodeClavicleLeft = FbxNode::Create(pScene, "Clavicle_Left");
-	pNodeSpineChest->AddChild(pNodeClavicleLeft);
-	nodes->push_back(pNodeClavicleLeft);
-	FbxNode* pNodeShoulderLeft = FbxNode::Create(pScene, "Shoulder_Left");
-	pNodeClavicleLeft->AddChild(pNodeShoulderLeft);
-	nodes->push_back(pNodeShoulderLeft);
-	FbxNode* pNodeElbowLeft = FbxNode::Create(pScene, "Elbow_Left");
-	pNodeShoulderLeft->AddChild(pNodeElbowLeft);
-	nodes->push_back(pNodeElbowLeft);
-	FbxNode* pNodeWristLeft = FbxNode::Create(pScene, "Wrist_Left");
-	pNodeElbowLeft->AddChild(pNodeWristLeft);
-	nodes->push_back(pNodeWristLeft);
-	FbxNode* pNodeHandLeft = FbxNode::Create(pScene, "Hand_Left");
-	pNodeWristLeft->AddChild(pNodeHandLeft);
-	nodes->push_back(pNodeHandLeft);
-	FbxNode* pNodeHandtipLeft = FbxNode::Create(pScene, "Handtip_Left");
-	pNodeHandLeft->AddChild(pNodeHandtipLeft);
-	nodes->push_back(pNodeHandtipLeft);
-	FbxNode* pNodeThumbLeft = FbxNode::Create(pScene, "Thumb_Left");
-	pNodeHandtipLeft->AddChild(pNodeThumbLeft);
-	nodes->push_back(pNodeThumbLeft);
-	FbxNode* pNodeClavicleRight = FbxNode::Create(pScene, "Clavical_Right");
-	pNodeSpineChest->AddChild(pNodeClavicleRight);
-	nodes->push_back(pNodeClavicleRight);
-	FbxNode* pNodeShoulderRight = FbxNode::Create(pScene, "Shoulder_Right");
-	pNodeClavicleRight->AddChild(pNodeShoulderRight);
-	nodes->push_back(pNodeShoulderRight);
-	FbxNode* pNodeElbowRight = FbxNode::Create(pScene, "Elbow_Right");
-	pNodeShoulderRight->AddChild(pNodeElbowRight);
-	nodes->push_back(pNodeElbowRight);
-	FbxNode* pNodeWristRight = FbxNode::Create(pScene, "Wrist_Right");
-	pNodeElbowRight->AddChild(pNodeWristRight);
-	nodes->push_back(pNodeWristRight);
-	FbxNode* pNodeHandRight = FbxNode::Create(pScene, "Hand_Right");
-	pNodeWristRight->AddChild(pNodeHandRight);
-	nodes->push_back(pNodeHandRight);
-	FbxNode* pNodeHandtipRight = FbxNode::Create(pScene, "Handtip_Right");
-	pNodeHandRight->AddChild(pNodeHandtipRight);
-	nodes->push_back(pNodeHandtipRight);
-	FbxNode* pNodeThumbRight = FbxNode::Create(pScene, "Thumb_Right");
-	pNodeHandtipRight->AddChild(pNodeThumbRight);
-	nodes->push_back(pNodeThumbRight);
-	FbxNode* pNodeHipLeft = FbxNode::Create(pScene, "Hip_Left");
-	pNodePelvis->AddChild(pNodeHipLeft);
-	nodes->push_back(pNodeHipLeft);
-	FbxNode* pNodeKneeLeft = FbxNode::Create(pScene, "Knee_Left");
-	pNodeHipLeft->AddChild(pNodeKneeLeft);
-	nodes->push_back(pNodeKneeLeft);
-	FbxNode* pNodeAnkleLeft = FbxNode::Create(pScene, "Ankle_Left");
-	pNodeKneeLeft->AddChild(pNodeAnkleLeft);
-	nodes->push_back(pNodeAnkleLeft);
-	FbxNode* pNodeFootLeft = FbxNode::Create(pScene, "Foot_Left");
-	pNodeAnkleLeft->AddChild(pNodeFootLeft);
-	nodes->push_back(pNodeFootLeft);
-	FbxNode* pNodeHipRight = FbxNode::Create(pScene, "Hip_Right");
-	pNodePelvis->AddChild(pNodeHipRight);
-	nodes->push_back(pNodeHipRight);
-	FbxNode* pNodeKneeRight = FbxNode::Create(pScene, "Knee_Right");
-	pNodeHipRight->AddChild(pNodeKneeRight);
-	nodes->push_back(pNodeKneeRight);
-	FbxNode* pNodeAnkleRight = FbxNode::Create(pScene, "Ankle_Right");
-	pNodeKneeRight->AddChild(pNodeAnkleRight);
-	nodes->push_back(pNodeAnkleRight);
-	FbxNode* pNodeFootRight = FbxNode::Create(pScene, "Foot_Right");
-	pNodeAnkleRight->AddChild(pNodeFootRight);
-	nodes->push_back(pNodeFootRight);
-	FbxNode* pNodeHead = FbxNode::Create(pScene, "Head");
-	pNodeNeck->AddChild(pNodeHead);
-	nodes->push_back(pNodeHead);
+	//Joints are created in body tracking order, which puts every parent before its children
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+		FbxNode* pNode = FbxNode::Create(pScene, skeletonJointNames[i]);
+		FbxNode* pParent = skeletonJointParents[i] < 0 ? pSkeleton : (*nodes)[skeletonJointParents[i]];
+		pParent->AddChild(pNode);
+		nodes->push_back(pNode);
+	}
 }
 
 void createMesh(FbxScene* pScene) {
@@ -273,7 +208,15 @@ void createMesh(FbxScene* pScene) {
 	lMesh->EndPolygon();
 }
 
-void CreateScene(FbxManager *pSdkManager, FbxScene* pScene, std::vector<k4abt_skeleton_t> skeletons, std::string fileName)
+//Translation curves of every joint, filled a chunk of frames at a time
+struct FbxSkeletonAnimation {
+	std::vector<FbxNode*> nodes;
+	FbxAnimCurve* curves[SKELETON_JOINT_COUNT][3];
+	size_t frameCount = 0;
+};
+
+//Creates the scene info, joint nodes and empty animation curves, keys are then added with addSkeletonKeys
+void beginSkeletonAnimation(FbxManager *pSdkManager, FbxScene* pScene, std::string fileName, FbxSkeletonAnimation* animation)
 {
 	//Create scene info
 	FbxDocumentInfo* sceneInfo = FbxDocumentInfo::Create(pSdkManager, "SceneInfo");
@@ -287,91 +230,94 @@ void CreateScene(FbxManager *pSdkManager, FbxScene* pScene, std::vector<k4abt_sk
 	pScene->SetSceneInfo(sceneInfo);
 
 	//Create nodes 
-	std::vector<FbxNode*> nodes;
-	createNodes(pScene, &nodes);
+	animation->nodes.clear();
+	createNodes(pScene, &animation->nodes);
 	
 	//Set up animation
 	FbxAnimStack* myAnimStack = FbxAnimStack::Create(pScene, fileName.c_str());
 	FbxAnimLayer* myAnimBaseLayer = FbxAnimLayer::Create(pScene, "Layer0");
 	myAnimStack->AddMember(myAnimBaseLayer);
-	FbxTime lTime;	
+
+	//Set up and start animation curves for each axis of the 27 skeleton nodes
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+		animation->curves[i][0] = animation->nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_X, true);
+		animation->curves[i][1] = animation->nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_Y, true);
+		animation->curves[i][2] = animation->nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_Z, true);
+		for (int axis = 0; axis < 3; axis++) {
+			animation->curves[i][axis]->KeyModifyBegin();
+		}
+	}
+	animation->frameCount = 0;
+}
+
+//Appends one key per frame of chunk to every curve. Nodes carry translation only, so a joint's global position is
+//its Kinect position and its local key is the offset from its parent's Kinect position in the same frame. This reads
+//the parent straight from the chunk instead of evaluating the parent's curves, which only needs the current chunk.
+void addSkeletonKeys(FbxSkeletonAnimation* animation, const SkeletonTrack& chunk)
+{
+	FbxTime lTime;
 	int lKeyIndex = 0;
-	FbxAnimCurve* xTranCurve = NULL;
-	FbxAnimCurve* yTranCurve = NULL;
-	FbxAnimCurve* zTranCurve = NULL;
-
-	//Create animation
-	for (int i = 0; i < nodes.size(); i++) { //Loop through 27 different skeleton nodes
-		//Set up animation curves for each axis
-		xTranCurve = nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_X, true);
-		yTranCurve = nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_Y, true);
-		zTranCurve = nodes[i]->LclTranslation.GetCurve(myAnimBaseLayer, FBXSDK_CURVENODE_COMPONENT_Z, true);
-		
-		//Start animation curves
-		xTranCurve->KeyModifyBegin();
-		yTranCurve->KeyModifyBegin();
-		zTranCurve->KeyModifyBegin();
-
-		for (int j = 0; j < skeletons.size(); j++) { //Loop through every frame from Kinect
+	//Flip the skeleton vertically
+	const float axisSign[3] = { 1, -1, 1 };
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) { //Loop through 27 different skeleton nodes
+		const std::vector<float>& positions = chunk.positions(i);
+		const std::vector<float>* parentPositions = skeletonJointParents[i] < 0 ? NULL : &chunk.positions(skeletonJointParents[i]);
+		for (size_t j = 0; j < chunk.size(); j++) { //Loop through every frame from Kinect
 			//Set time
-			lTime.SetSecondDouble(j*(1.0 / 30));
-			
-			float position, offset;
-			//Set x-axis position
-			position = skeletons[j].joints[i].position.xyz.x;
-			if(nodes[i]->GetParent()) {
-				offset = nodes[i]->GetParent()->EvaluateGlobalTransform(lTime).GetT()[0];
-				position -= offset;
-			}
-			lKeyIndex = xTranCurve->KeyAdd(lTime);
-			xTranCurve->KeySet(lKeyIndex, lTime,
-				position, 
-				FbxAnimCurveDef::eInterpolationLinear);
-
-			//Set y-axis position
-			position = -1 * skeletons[j].joints[i].position.xyz.y;
-			if (nodes[i]->GetParent()) {
-				offset = nodes[i]->GetParent()->EvaluateGlobalTransform(lTime).GetT()[1];
-				position -= offset;
-				//position *= -1; //Flip the skeleton vertically
-			}			
-			lKeyIndex = yTranCurve->KeyAdd(lTime);
-			yTranCurve->KeySet(lKeyIndex, lTime,
-				position,
-				FbxAnimCurveDef::eInterpolationLinear);
-
-			//Set z-axis position
-			position = skeletons[j].joints[i].position.xyz.z;
-			if (nodes[i]->GetParent()) {
-				offset = nodes[i]->GetParent()->EvaluateGlobalTransform(lTime).GetT()[2];
-				position -= offset;
+			lTime.SetSecondDouble((animation->frameCount + j) * (1.0 / 30));
+
+			for (int axis = 0; axis < 3; axis++) {
+				float position = axisSign[axis] * positions[j * 3 + axis];
+				if (parentPositions != NULL) {
+					position -= axisSign[axis] * (*parentPositions)[j * 3 + axis];
+				}
+				FbxAnimCurve* curve = animation->curves[i][axis];
+				lKeyIndex = curve->KeyAdd(lTime);
+				curve->KeySet(lKeyIndex, lTime,
+					position,
+					FbxAnimCurveDef::eInterpolationLinear);
 			}
-			lKeyIndex = zTranCurve->KeyAdd(lTime);
-			zTranCurve->KeySet(lKeyIndex, lTime,
-				position,
-				FbxAnimCurveDef::eInterpolationLinear);
 		}
-		//End animation curves
-		xTranCurve->KeyModifyEnd();
-		yTranCurve->KeyModifyEnd();
-		zTranCurve->KeyModifyEnd();
 	}
+	animation->frameCount += chunk.size();
 }
 
-bool createFBX(std::vector<k4abt_skeleton_t> skeletons, const char* output_path) {
-	FbxManager* lSdkManager = NULL;
-	FbxScene* lScene = NULL;
+void endSkeletonAnimation(FbxSkeletonAnimation* animation)
+{
+	//End animation curves
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			animation->curves[i][axis]->KeyModifyEnd();
+		}
+	}
+}
+
+void CreateScene(FbxManager *pSdkManager, FbxScene* pScene, const SkeletonTrack& track, std::string fileName)
+{
+	FbxSkeletonAnimation animation;
+	beginSkeletonAnimation(pSdkManager, pScene, fileName, &animation);
+	addSkeletonKeys(&animation, track);
+	endSkeletonAnimation(&animation);
+}
+
+//Exports with an already initialized manager so callers converting many files only load the SDK plugins once
+bool createFBX(FbxManager* lSdkManager, const SkeletonTrack& track, const char* output_path) {
 	bool lResult;
 
 	//Get file name as string
 	std::experimental::filesystem::path path = output_path;
 	std::string fileName = path.stem().string();
 
-	//Prepare the FBX SDK.
-	InitializeSdkObjects(lSdkManager, lScene);
+	//Create an FBX scene in the existing manager
+	FbxScene* lScene = FbxScene::Create(lSdkManager, "My Scene");
+	if (!lScene)
+	{
+		FBXSDK_printf("Error: Unable to create FBX scene!\n");
+		return false;
+	}
 
 	//Create the scene.
-	CreateScene(lSdkManager, lScene, skeletons, fileName);
+	CreateScene(lSdkManager, lScene, track, fileName);
 
 	//Add a mesh to scene.
 	createMesh(lScene);
@@ -379,8 +325,130 @@ bool createFBX(std::vector<k4abt_skeleton_t> skeletons, const char* output_path)
 	//Save scene
 	lResult = SaveScene(lSdkManager, lScene, output_path, -1, false);
 
+	//Destroy the scene and everything it owns, the manager stays alive
+	lScene->Destroy();
+
+	return lResult;
+}
+
+bool createFBX(const SkeletonTrack& track, const char* output_path) {
+	FbxManager* lSdkManager = NULL;
+	bool lResult;
+
+	//Prepare the FBX SDK.
+	InitializeSdkManager(lSdkManager);
+
+	//Create and save the scene
+	lResult = createFBX(lSdkManager, track, output_path);
+
 	//Destroy all objects created by the FBX SDK
 	DestroySdkObjects(lSdkManager, lResult);
 
 	return lResult;
+}
+
+//Reads every animation stack of an FBX file written by createFBX back into a take of the same name, with an already
+//initialized manager. Joints are found by name and resampled at IMPORT_FRAME_RATE from their evaluated global
+//transforms with the vertical flip of the export undone, orientations included. createFBX only animates
+//translations, so its own files read back with identity orientations.
+std::string readFBX(FbxManager* lSdkManager, const char* input_path, std::vector<SkeletonTake>* takes) {
+	std::string errorMessage = "";
+
+	//Import the file into a scene of the existing manager
+	FbxScene* lScene = FbxScene::Create(lSdkManager, "Import Scene");
+	FbxImporter* lImporter = FbxImporter::Create(lSdkManager, "");
+	if (!lImporter->Initialize(input_path, -1, lSdkManager->GetIOSettings())) {
+		errorMessage += std::string("Failed to open FBX: ") + lImporter->GetStatus().GetErrorString() + "\n";
+	}
+	else if (!lImporter->Import(lScene)) {
+		errorMessage += std::string("Failed to import FBX: ") + lImporter->GetStatus().GetErrorString() + "\n";
+	}
+	lImporter->Destroy();
+
+	FbxNode* nodes[SKELETON_JOINT_COUNT];
+	for (int i = 0; i < SKELETON_JOINT_COUNT && errorMessage == ""; i++) {
+		nodes[i] = lScene->GetRootNode()->FindChild(skeletonJointNames[i], true);
+		if (nodes[i] == NULL) {
+			errorMessage += std::string("No node for joint ") + skeletonJointNames[i] + ", the file is not a skeleton export.\n";
+		}
+	}
+
+	//Flip the skeleton vertically again
+	const float axisSign[3] = { 1, -1, 1 };
+	for (int s = 0; errorMessage == "" && s < lScene->GetSrcObjectCount<FbxAnimStack>(); s++) {
+		FbxAnimStack* lAnimStack = lScene->GetSrcObject<FbxAnimStack>(s);
+		FbxAnimLayer* lAnimLayer = lAnimStack->GetMember<FbxAnimLayer>(0);
+		lScene->SetCurrentAnimationStack(lAnimStack);
+
+		//The take spans the keys of every joint curve
+		double start = 0, end = 0;
+		bool keyed = false;
+		for (int i = 0; i < SKELETON_JOINT_COUNT && lAnimLayer != NULL; i++) {
+			const char* components[3] = { FBXSDK_CURVENODE_COMPONENT_X, FBXSDK_CURVENODE_COMPONENT_Y, FBXSDK_CURVENODE_COMPONENT_Z };
+			for (int axis = 0; axis < 3; axis++) {
+				FbxAnimCurve* curve = nodes[i]->LclTranslation.GetCurve(lAnimLayer, components[axis]);
+				if (curve == NULL || curve->KeyGetCount() == 0) {
+					continue;
+				}
+				double first = curve->KeyGetTime(0).GetSecondDouble();
+				double last = curve->KeyGetTime(curve->KeyGetCount() - 1).GetSecondDouble();
+				start = keyed ? std::min(start, first) : first;
+				end = keyed ? std::max(end, last) : last;
+				keyed = true;
+			}
+		}
+		if (!keyed) {
+			continue;
+		}
+
+		SkeletonTake take;
+		take.name = lAnimStack->GetName();
+		size_t frameCount = (size_t)std::floor((end - start) * IMPORT_FRAME_RATE + 0.5) + 1;
+		take.track.reserve(frameCount);
+		FbxTime lTime;
+		for (size_t j = 0; j < frameCount; j++) {
+			lTime.SetSecondDouble(start + (double)j / IMPORT_FRAME_RATE);
+			k4abt_skeleton_t skeleton = k4abt_skeleton_t();
+			for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+				FbxAMatrix& transform = nodes[i]->EvaluateGlobalTransform(lTime);
+				FbxVector4 position = transform.GetT();
+				FbxQuaternion rotation = transform.GetQ();
+				k4abt_joint_t& joint = skeleton.joints[i];
+				joint.position.xyz.x = (float)(axisSign[0] * position[0]);
+				joint.position.xyz.y = (float)(axisSign[1] * position[1]);
+				joint.position.xyz.z = (float)(axisSign[2] * position[2]);
+				//Mirroring y negates the rotation about x and z
+				joint.orientation.wxyz.w = (float)rotation[3];
+				joint.orientation.wxyz.x = (float)-rotation[0];
+				joint.orientation.wxyz.y = (float)rotation[1];
+				joint.orientation.wxyz.z = (float)-rotation[2];
+				joint.confidence_level = IMPORT_JOINT_CONFIDENCE;
+			}
+			take.track.append(skeleton, (uint64_t)(j * 1000000 / IMPORT_FRAME_RATE));
+		}
+		takes->push_back(std::move(take));
+	}
+	if (errorMessage == "" && takes->empty()) {
+		errorMessage += "The file has no animations.\n";
+	}
+
+	//Destroy the scene and everything it owns, the manager stays alive
+	lScene->Destroy();
+
+	return errorMessage;
+}
+
+std::string readFBX(const char* input_path, std::vector<SkeletonTake>* takes) {
+	FbxManager* lSdkManager = NULL;
+
+	//Prepare the FBX SDK.
+	InitializeSdkManager(lSdkManager);
+
+	//Read the takes
+	std::string errorMessage = readFBX(lSdkManager, input_path, takes);
+
+	//Destroy all objects created by the FBX SDK
+	DestroySdkObjects(lSdkManager, errorMessage == "");
+
+	return errorMessage;
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "gltfFunctions.h"
+#include "meshoptFunctions.h"
+#include "checkerFunctions.h"
+#include "profilerFunctions.h"
+#include "captureSourceFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#define GLTF_BENCH_DEFAULT_FRAMES 100000
+
+//The per-float modulo loop the exporter used before, kept as the benchmark baseline
+void scalarJointBounds(const SkeletonTrack& track, JointBounds bounds[27]) {
+	for (int h = 0; h < 27; h++) {
+		bounds[h] = JointBounds();
+		const std::vector<float>& positions = track.positions(h);
+		const size_t positionCount = positions.size();
+		for (size_t i = 0U, j = 0U; i < positionCount; ++i, j = (i % 3U)) {
+			bounds[h].min[j] = std::min(positions[i], bounds[h].min[j]);
+			bounds[h].max[j] = std::max(positions[i], bounds[h].max[j]);
+		}
+	}
+}
+
+//Encodes every column with the meshopt attribute codec, decodes it again and checks the round trip is exact.
+//Returns the encoded size, or 0 if a column did not survive.
+size_t meshoptRoundTrip(const std::vector<std::vector<uint8_t>>& columns, size_t stride, double* encodeSeconds, double* decodeSeconds) {
+	std::vector<std::vector<uint8_t>> encoded(columns.size());
+	std::vector<std::vector<uint8_t>> decoded(columns.size());
+	*encodeSeconds = timeBenchmarkPasses([&]() {
+		for (size_t c = 0; c < columns.size(); c++) {
+			meshoptEncodeAttributes(columns[c].data(), columns[c].size() / stride, stride, &encoded[c]);
+		}
+	});
+	std::string errorMessage = "";
+	*decodeSeconds = timeBenchmarkPasses([&]() {
+		for (size_t c = 0; c < columns.size(); c++) {
+			decoded[c].resize(columns[c].size());
+			errorMessage += meshoptDecodeAttributes(encoded[c].data(), encoded[c].size(), columns[c].size() / stride, stride, decoded[c].data());
+		}
+	});
+	size_t encodedBytes = 0;
+	for (size_t c = 0; c < columns.size(); c++) {
+		if (decoded[c] != columns[c]) {
+			return 0;
+		}
+		encodedBytes += encoded[c].size();
+	}
+	return errorMessage == "" ? encodedBytes : 0;
+}
+
+//Measures glTF accessor construction on a generated session of frameCount frames: the bounds pass with the scalar
+//baseline, SIMD on one thread and SIMD across workerCount threads, the meshopt codec on float translations and on
+//float and quantised rotations, then a full export to output_path if one is given
+std::string gltfBenchModeFunction(const char* output_path, const GltfExportOptions& options, int frameCount = GLTF_BENCH_DEFAULT_FRAMES, int workerCount = 0) {
+	if (frameCount < 1) {
+		return "glTF benchmark needs at least one frame.\n";
+	}
+	if (output_path != NULL && fileExists(output_path)) {
+		return "Output file already exists, please choose another name.\n";
+	}
+	if (output_path != NULL && !outputGLTF(output_path) && !outputGLB(output_path)) {
+		return "Invalid output type. Use gltf or glb.\n";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	SkeletonTrack track;
+	createSyntheticTrack((size_t)frameCount, SYNTHETIC_DEFAULT_FPS, &track);
+	std::chrono::duration<double> fillSeconds = std::chrono::steady_clock::now() - start;
+
+	JointBounds scalarBounds[27], simdBounds[27], parallelBounds[27];
+	double scalarSeconds = timeBenchmarkPasses([&]() { scalarJointBounds(track, scalarBounds); });
+	double simdSeconds = timeBenchmarkPasses([&]() { computeJointBounds(track, simdBounds, 1); });
+	double parallelSeconds = timeBenchmarkPasses([&]() { computeJointBounds(track, parallelBounds, workerCount); });
+	for (int h = 0; h < 27; h++) {
+		if (std::memcmp(scalarBounds[h].min, simdBounds[h].min, sizeof(scalarBounds[h].min)) != 0
+			|| std::memcmp(scalarBounds[h].max, simdBounds[h].max, sizeof(scalarBounds[h].max)) != 0
+			|| std::memcmp(simdBounds[h].min, parallelBounds[h].min, sizeof(simdBounds[h].min)) != 0
+			|| std::memcmp(simdBounds[h].max, parallelBounds[h].max, sizeof(simdBounds[h].max)) != 0) {
+			return "Joint bounds differ between the scalar and SIMD paths.\n";
+		}
+	}
+
+	double positionMegabytes = track.size() * 27 * 3 * sizeof(float) / 1e6;
+	std::cout << "Frames: " << track.size() << " (synthetic, " << positionMegabytes << " MB of positions, filled in "
+		<< fillSeconds.count() * 1000 << " ms)" << std::endl;
+	std::cout << "Bounds scalar: " << scalarSeconds * 1000 << " ms (" << positionMegabytes / scalarSeconds << " MB/s)" << std::endl;
+	std::cout << "Bounds SIMD: " << simdSeconds * 1000 << " ms (" << positionMegabytes / simdSeconds << " MB/s, "
+		<< scalarSeconds / simdSeconds << "x)" << std::endl;
+	std::cout << "Bounds SIMD parallel: " << parallelSeconds * 1000 << " ms (" << positionMegabytes / parallelSeconds << " MB/s, "
+		<< scalarSeconds / parallelSeconds << "x)" << std::endl;
+
+	//Meshopt on each joint's channels as the exporter lays them out: float translations, and rotations as float or
+	//as the normalised int16 quaternions -quantize writes
+	std::vector<std::vector<uint8_t>> floatColumns(27), rotationColumns(27), quantizedColumns(27);
+	for (int h = 0; h < 27; h++) {
+		const std::vector<float>& positions = track.positions(h);
+		floatColumns[h].assign((const uint8_t*)positions.data(), (const uint8_t*)(positions.data() + positions.size()));
+		const std::vector<float>& orientations = track.orientations(h);
+		rotationColumns[h].assign((const uint8_t*)orientations.data(), (const uint8_t*)(orientations.data() + orientations.size()));
+		std::vector<int16_t> quantized;
+		double quantizationError = 0;
+		QuantizeRotations(orientations, quantized, quantizationError);
+		quantizedColumns[h].assign((const uint8_t*)quantized.data(), (const uint8_t*)(quantized.data() + quantized.size()));
+	}
+	double rotationMegabytes = positionMegabytes * 4 / 3;
+	double encodeSeconds, decodeSeconds;
+	size_t floatEncoded = meshoptRoundTrip(floatColumns, 12, &encodeSeconds, &decodeSeconds);
+	if (floatEncoded == 0) {
+		return "Meshopt round trip of float translations is not exact.\n";
+	}
+	std::cout << "Meshopt float: " << floatEncoded / 1e6 << " MB (" << positionMegabytes * 1e6 / floatEncoded << "x), encode "
+		<< positionMegabytes / encodeSeconds << " MB/s, decode " << positionMegabytes / decodeSeconds << " MB/s, round trip exact" << std::endl;
+	size_t rotationEncoded = meshoptRoundTrip(rotationColumns, 16, &encodeSeconds, &decodeSeconds);
+	if (rotationEncoded == 0) {
+		return "Meshopt round trip of float rotations is not exact.\n";
+	}
+	std::cout << "Meshopt float rotations: " << rotationEncoded / 1e6 << " MB (" << rotationMegabytes * 1e6 / rotationEncoded << "x), encode "
+		<< rotationMegabytes / encodeSeconds << " MB/s, decode " << rotationMegabytes / decodeSeconds << " MB/s, round trip exact" << std::endl;
+	size_t quantizedEncoded = meshoptRoundTrip(quantizedColumns, 8, &encodeSeconds, &decodeSeconds);
+	if (quantizedEncoded == 0) {
+		return "Meshopt round trip of quantised rotations is not exact.\n";
+	}
+	std::cout << "Meshopt int16 rotations: " << quantizedEncoded / 1e6 << " MB (" << rotationMegabytes * 1e6 / quantizedEncoded << "x vs float), encode "
+		<< rotationMegabytes / 2 / encodeSeconds << " MB/s, decode " << rotationMegabytes / 2 / decodeSeconds << " MB/s, round trip exact" << std::endl;
+
+	//Full export, bounds included
+	if (output_path != NULL) {
+		createOutputDirectory(output_path);
+		start = std::chrono::steady_clock::now();
+		bool success = createGLTF(track, output_path, options);
+		std::chrono::duration<double> exportSeconds = std::chrono::steady_clock::now() - start;
+		if (!success) {
+			return "An error occurred while creating the gltf.\n";
+		}
+		std::cout << "Export: " << exportSeconds.count() * 1000 << " ms (" << track.size() / exportSeconds.count() << " frames/sec)" << std::endl;
+	}
+	return "";
+}
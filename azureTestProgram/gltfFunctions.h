@@ -7,13 +7,152 @@
 #include <GLTFSDK/IStreamWriter.h>
 #include <GLTFSDK/BufferBuilder.h>
 
+#include "skeletonTrackFunctions.h"
+#include "skeletonPoseFunctions.h"
+#include "splineFitFunctions.h"
+#include "meshoptFunctions.h"
+
 #include <experimental/filesystem>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <functional>
+#include <thread>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+//Rotation tolerance of spline fitted exports when only the translation tolerance is given
+#define GLTF_SPLINE_DEFAULT_DEGREES 0.5
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define GLTF_BOUNDS_SSE 1
+#endif
 
 using namespace Microsoft::glTF;
 
+//Per-axis range of one joint's positions, stored in the accessor's min and max
+struct JointBounds {
+	float min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	float max[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+};
+
+//Grows bounds to cover count xyz triples. Four triples are three SSE registers whose lanes repeat the axes as
+//x y z x | y z x y | z x y z, so the registers are reduced lane-wise and only split into axes at the end.
+void growJointBounds(const float* positions, size_t count, JointBounds* bounds) {
+	size_t i = 0;
+#ifdef GLTF_BOUNDS_SSE
+	if (count >= 4) {
+		__m128 minA = _mm_loadu_ps(positions), minB = _mm_loadu_ps(positions + 4), minC = _mm_loadu_ps(positions + 8);
+		__m128 maxA = minA, maxB = minB, maxC = minC;
+		for (i = 4; i + 4 <= count; i += 4) {
+			const float* p = positions + i * 3;
+			__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+			minA = _mm_min_ps(minA, a); minB = _mm_min_ps(minB, b); minC = _mm_min_ps(minC, c);
+			maxA = _mm_max_ps(maxA, a); maxB = _mm_max_ps(maxB, b); maxC = _mm_max_ps(maxC, c);
+		}
+		float lanes[2][12];
+		_mm_storeu_ps(lanes[0], minA); _mm_storeu_ps(lanes[0] + 4, minB); _mm_storeu_ps(lanes[0] + 8, minC);
+		_mm_storeu_ps(lanes[1], maxA); _mm_storeu_ps(lanes[1] + 4, maxB); _mm_storeu_ps(lanes[1] + 8, maxC);
+		for (int lane = 0; lane < 12; lane++) {
+			bounds->min[lane % 3] = std::min(bounds->min[lane % 3], lanes[0][lane]);
+			bounds->max[lane % 3] = std::max(bounds->max[lane % 3], lanes[1][lane]);
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			bounds->min[axis] = std::min(bounds->min[axis], positions[i * 3 + axis]);
+			bounds->max[axis] = std::max(bounds->max[axis], positions[i * 3 + axis]);
+		}
+	}
+}
+
+//Bounds of every joint of a track, joints are split across workerCount threads (0 uses every core)
+void computeJointBounds(const SkeletonTrack& track, JointBounds bounds[27], int workerCount = 0) {
+	if (workerCount <= 0) {
+		workerCount = (int)std::max(1U, std::thread::hardware_concurrency());
+	}
+	workerCount = std::min(workerCount, 27);
+	auto boundJoints = [&](int first) {
+		for (int h = first; h < 27; h += workerCount) {
+			bounds[h] = JointBounds();
+			growJointBounds(track.positions(h).data(), track.size(), &bounds[h]);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int w = 1; w < workerCount; w++) {
+		workers.push_back(std::thread(boundJoints, w));
+	}
+	boundJoints(0);
+	for (size_t w = 0; w < workers.size(); w++) {
+		workers[w].join();
+	}
+}
+
+//Options for a glTF export, read from the command line and passed down to each exporter
+struct GltfExportOptions {
+	//Joint nodes in the tracker's hierarchy with rotation channels and a skinned mesh, instead of free moving points
+	bool rigged = false;
+	//Normalised int16 rotation channels for rigged exports, translations stay float as core glTF requires
+	bool quantized = false;
+	//Animation buffer views compressed with EXT_meshopt_compression
+	bool meshopt = false;
+	//CUBICSPLINE samplers fitted within these tolerances instead of a linear key every frame, 0 mm turns fitting off
+	double splineToleranceMm = 0;
+	double splineToleranceDegrees = GLTF_SPLINE_DEFAULT_DEGREES;
+};
+
+//Animation data of one joint for every frame: xyz translations, and xyzw rotations for rigged exports. The vectors
+//only have to stay valid until the next call, so sessions spilled to disk can load one joint at a time.
+struct JointChannels {
+	const std::vector<float>* translations = NULL;
+	const std::vector<float>* rotations = NULL;
+};
+typedef std::function<JointChannels(int joint)> JointChannelLoader;
+
+//One animation of the document, frameCount frames whose joint channels come from loadChannels. Accessor min and
+//max must match the values they hold, so bounds cover only the translations this take writes.
+struct GltfTake {
+	std::string name;
+	size_t frameCount = 0;
+	JointBounds bounds[27];
+	JointChannelLoader loadChannels;
+};
+
+//Everything written besides the takes' joint channels, which all animate the same nodes. Rigged translations are
+//relative to the parent joint, and rigged documents are bound to the first take's first frame.
+struct GltfAnimationDesc {
+	bool rigged = false;
+	bool quantized = false;
+	bool meshopt = false;
+	double splineToleranceMm = 0;
+	double splineToleranceDegrees = 0;
+	SkeletonBindPose bindPose;
+};
+
+//Copies the export options into desc. Only rotations may be quantised, so documents without rotation channels
+//stay float, and fitted tangents can leave the normalised range, so spline fitted channels stay float too.
+void applyGltfExportOptions(const GltfExportOptions& options, GltfAnimationDesc* desc) {
+	desc->rigged = options.rigged;
+	desc->splineToleranceMm = options.splineToleranceMm;
+	desc->splineToleranceDegrees = options.splineToleranceDegrees;
+	desc->quantized = options.quantized && desc->rigged && desc->splineToleranceMm <= 0;
+	desc->meshopt = options.meshopt;
+}
+
+//Normalised int16 for a value in [-1, 1], and the value glTF readers expand it back to
+int16_t quantizeSnorm16(float value) {
+	return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+float dequantizeSnorm16(int16_t value) {
+	return std::max(value / 32767.0f, -1.0f);
+}
+
 namespace {
 
 	class StreamWriter : public IStreamWriter
@@ -51,87 +190,443 @@ namespace {
 		std::experimental::filesystem::path m_pathBase;
 	};
 
-	void addPositionData(std::vector<k4abt_skeleton_t> skeletons, std::vector<float> positions[27]) {
-		for (int i = 0; i < 27; i++) {	
-			for (int j = 0; j < skeletons.size(); j++) {
-				positions[i].push_back(skeletons[j].joints[i].position.xyz.x);
-				positions[i].push_back(skeletons[j].joints[i].position.xyz.y);
-				positions[i].push_back(skeletons[j].joints[i].position.xyz.z);
+	//Keeps the buffer stream in memory, for buffers that are rewritten before they reach the file
+	class MemoryStreamWriter : public IStreamWriter
+	{
+	public:
+		std::shared_ptr<std::ostream> GetOutputStream(const std::string& filename) const override
+		{
+			m_stream = std::make_shared<std::stringstream>(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+			return m_stream;
+		}
+
+		std::string contents() const
+		{
+			return m_stream ? m_stream->str() : std::string();
+		}
+
+	private:
+		mutable std::shared_ptr<std::stringstream> m_stream;
+	};
+
+	//Size of the marker each joint of a rigged export carries, in the tracker's millimetres
+	const float JOINT_MARKER_RADIUS = 15.0f;
+
+	struct TakeAccessorIds {
+		std::string translationTimes[27];
+		std::string rotationTimes[27];
+		std::string translations[27];
+		std::string rotations[27];
+	};
+
+	struct SkeletonAccessorIds {
+		std::vector<TakeAccessorIds> takes;
+		std::string inverseBindMatrices;
+		std::string meshPositions;
+		std::string meshJoints;
+		std::string meshWeights;
+		std::string meshIndices;
+	};
+
+	//An octahedron around every joint's bind position, fully weighted to that joint, so viewers have something to skin
+	void CreateJointMesh(const SkeletonBindPose& bindPose, std::vector<float>& positions, std::vector<uint8_t>& joints, std::vector<float>& weights, std::vector<uint16_t>& indices) {
+		static const float corners[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		static const uint16_t faces[8][3] = { { 0, 2, 4 }, { 2, 1, 4 }, { 1, 3, 4 }, { 3, 0, 4 }, { 2, 0, 5 }, { 1, 2, 5 }, { 3, 1, 5 }, { 0, 3, 5 } };
+		for (int h = 0; h < 27; h++) {
+			uint16_t first = (uint16_t)(positions.size() / 3);
+			for (int v = 0; v < 6; v++) {
+				for (int axis = 0; axis < 3; axis++) {
+					positions.push_back(bindPose.position[h][axis] + corners[v][axis] * JOINT_MARKER_RADIUS);
+				}
+				joints.insert(joints.end(), { (uint8_t)h, 0, 0, 0 });
+				weights.insert(weights.end(), { 1.0f, 0.0f, 0.0f, 0.0f });
+			}
+			for (int f = 0; f < 8; f++) {
+				for (int v = 0; v < 3; v++) {
+					indices.push_back(first + faces[f][v]);
+				}
+			}
+		}
+	}
+
+	//Largest difference between the written and the original channels of a quantised or spline fitted export, and
+	//the channel payload and key count against one float key per frame
+	struct ChannelReport {
+		double translationErrorMm = 0;
+		double rotationErrorDegrees = 0;
+		size_t bytes = 0;
+		size_t floatBytes = 0;
+		size_t keys = 0;
+		size_t frameKeys = 0;
+		size_t compressedBytes = 0;
+		size_t uncompressedBytes = 0;
+	};
+
+	//Normalised int16 rotations are core glTF. The error is the rotation between the original and the renormalised
+	//result, taken from the chord between them since acos loses the small angles near one.
+	void QuantizeRotations(const std::vector<float>& rotations, std::vector<int16_t>& quantized, double& maxErrorDegrees) {
+		quantized.resize(rotations.size());
+		for (size_t i = 0; i < rotations.size(); i += 4) {
+			double original[4], restored[4], originalLength = 0, restoredLength = 0, dot = 0;
+			for (int c = 0; c < 4; c++) {
+				quantized[i + c] = quantizeSnorm16(rotations[i + c]);
+				original[c] = rotations[i + c];
+				restored[c] = dequantizeSnorm16(quantized[i + c]);
+				originalLength += original[c] * original[c];
+				restoredLength += restored[c] * restored[c];
+				dot += original[c] * restored[c];
+			}
+			if (originalLength <= 0 || restoredLength <= 0) {
+				continue;
+			}
+			double chord = 0;
+			for (int c = 0; c < 4; c++) {
+				double difference = original[c] / std::sqrt(originalLength) - (dot < 0 ? -1 : 1) * restored[c] / std::sqrt(restoredLength);
+				chord += difference * difference;
 			}
+			maxErrorDegrees = std::max(maxErrorDegrees, 4.0 * std::asin(std::min(std::sqrt(chord) * 0.5, 1.0)) * 180.0 / 3.14159265358979);
 		}
 	}
 
-	void CreateSkeletonResources(std::vector<k4abt_skeleton_t> skeletons, std::string fileName, Document& document, BufferBuilder& bufferBuilder, std::string& accessorIdTime, std::string accessorIdPositions[27]) {
+	//Animation data shares one untargeted view per run of accessors. Meshopt exports give every accessor a view of its
+	//own instead, so each compressed view has a single element stride.
+	void AddAnimationView(const GltfAnimationDesc& desc, BufferBuilder& bufferBuilder, bool& viewOpen) {
+		if (desc.meshopt || !viewOpen) {
+			bufferBuilder.AddBufferView();
+			viewOpen = true;
+		}
+	}
+
+	//Key times and in-tangent, value, out-tangent triples of one fitted channel
+	void AddSplineAccessors(const GltfAnimationDesc& desc, BufferBuilder& bufferBuilder, bool& viewOpen, const SplineChannel& spline, AccessorType type, std::string& accessorIdTime, std::string& accessorIdOutput) {
+		std::vector<float> timeMin(1U, spline.times.front());
+		std::vector<float> timeMax(1U, spline.times.back());
+		AddAnimationView(desc, bufferBuilder, viewOpen);
+		accessorIdTime = bufferBuilder.AddAccessor(spline.times, { TYPE_SCALAR, COMPONENT_FLOAT, false, std::move(timeMin), std::move(timeMax) }).id;
+		AddAnimationView(desc, bufferBuilder, viewOpen);
+		accessorIdOutput = bufferBuilder.AddAccessor(spline.values, { type, COMPONENT_FLOAT }).id;
+	}
+
+	void AddSplineReport(const SplineChannel& spline, size_t frameCount, int width, double& maxError, ChannelReport& report) {
+		maxError = std::max(maxError, spline.maxError);
+		report.keys += spline.times.size();
+		report.frameKeys += frameCount;
+		report.bytes += (spline.times.size() + spline.values.size()) * sizeof(float);
+		report.floatBytes += frameCount * (width + 1) * sizeof(float);
+	}
+
+	void CreateSkeletonResources(const GltfAnimationDesc& desc, const std::vector<GltfTake>& takes, std::string bufferId, Document& document, BufferBuilder& bufferBuilder, SkeletonAccessorIds& accessorIds, ChannelReport& report) {
 		//Create buffer to store all resource data
-		const char* bufferId = fileName.c_str();
-		bufferBuilder.AddBuffer(bufferId);
-
-		//Create buffer view for keyframe times
-		bufferBuilder.AddBufferView(BufferViewTarget::ELEMENT_ARRAY_BUFFER);
-		std::vector<float> times; //Create times based off input being 30fps
-		for (int i = 0; i < skeletons.size(); i++) {
-			times.push_back(i / 30.0f);
-		}
-		accessorIdTime = bufferBuilder.AddAccessor(times, { TYPE_SCALAR, COMPONENT_FLOAT }).id;
-
-		//Create buffer views for animation node data
-		bufferBuilder.AddBufferView(BufferViewTarget::ARRAY_BUFFER);
-		std::vector<float> positions[27];
-		addPositionData(skeletons, positions);
-		std::vector<float> minValues[27]; 
-		std::vector<float> maxValues[27]; 
-		for (int i = 0; i < 27; i++) {
-			minValues[i] = std::vector<float>(3U, std::numeric_limits<float>::max());
-			maxValues[i] = std::vector<float>(3U, std::numeric_limits<float>::lowest());
+		bufferBuilder.AddBuffer(bufferId.c_str());
+		accessorIds.takes.resize(takes.size());
+
+		//Keyframe times and every joint's channels share one contiguous buffer view. Animation data is not
+		//vertex or index data, so the view has no target, and sampler outputs may not be strided, so each joint's
+		//channels follow one another as a block.
+		bool viewOpen = false;
+		for (size_t t = 0; t < takes.size(); t++) {
+			const GltfTake& take = takes[t];
+			TakeAccessorIds& takeIds = accessorIds.takes[t];
+			if (desc.splineToleranceMm > 0) {
+				//Every fitted channel keeps its own keys, so each sampler gets its own times
+				SplineChannel spline;
+				for (int h = 0; h < 27; h++) {
+					JointChannels channels = take.loadChannels(h);
+					fitCubicSpline(*channels.translations, take.frameCount, 3, 1 / 30.0, desc.splineToleranceMm, false, &spline);
+					AddSplineAccessors(desc, bufferBuilder, viewOpen, spline, TYPE_VEC3, takeIds.translationTimes[h], takeIds.translations[h]);
+					AddSplineReport(spline, take.frameCount, 3, report.translationErrorMm, report);
+					if (desc.rigged) {
+						fitCubicSpline(*channels.rotations, take.frameCount, 4, 1 / 30.0, desc.splineToleranceDegrees, true, &spline);
+						AddSplineAccessors(desc, bufferBuilder, viewOpen, spline, TYPE_VEC4, takeIds.rotationTimes[h], takeIds.rotations[h]);
+						AddSplineReport(spline, take.frameCount, 4, report.rotationErrorDegrees, report);
+					}
+				}
+				continue;
+			}
+
+			std::vector<float> times(take.frameCount); //Create times based off input being 30fps
+			for (size_t i = 0; i < take.frameCount; i++) {
+				times[i] = i / 30.0f;
+			}
+			//Animation inputs must declare their range
+			std::vector<float> timeMin(1U, times.empty() ? 0.0f : times.front());
+			std::vector<float> timeMax(1U, times.empty() ? 0.0f : times.back());
+			AddAnimationView(desc, bufferBuilder, viewOpen);
+			std::string accessorIdTime = bufferBuilder.AddAccessor(times, { TYPE_SCALAR, COMPONENT_FLOAT, false, std::move(timeMin), std::move(timeMax) }).id;
+			std::fill(takeIds.translationTimes, takeIds.translationTimes + 27, accessorIdTime);
+			std::fill(takeIds.rotationTimes, takeIds.rotationTimes + 27, accessorIdTime);
+
+			//Add animation node data, each joint's channels are already contiguous and its bounds already known
+			for (int h = 0; h < 27; h++) {
+				JointChannels channels = take.loadChannels(h);
+				std::vector<float> minValues(take.bounds[h].min, take.bounds[h].min + 3);
+				std::vector<float> maxValues(take.bounds[h].max, take.bounds[h].max + 3);
+				AddAnimationView(desc, bufferBuilder, viewOpen);
+				takeIds.translations[h] = bufferBuilder.AddAccessor(*channels.translations, { TYPE_VEC3, COMPONENT_FLOAT, false, std::move(minValues), std::move(maxValues) }).id;
+				if (desc.rigged && !desc.quantized) {
+					AddAnimationView(desc, bufferBuilder, viewOpen);
+					takeIds.rotations[h] = bufferBuilder.AddAccessor(*channels.rotations, { TYPE_VEC4, COMPONENT_FLOAT }).id;
+				}
+			}
 		}
-		const size_t positionCount = positions[0].size();
-		for (int h = 0; h < 27; h++) {
-			for (size_t i = 0U, j = 0U; i < positionCount; ++i, j = (i % 3U)) {
-				minValues[h][j] = std::min(positions[h][i], minValues[h][j]);
-				maxValues[h][j] = std::max(positions[h][i], maxValues[h][j]);
+
+		if (desc.rigged) {
+			//Inverse bind matrices are read by the skin, not by the vertex pipeline, so they join the untargeted view
+			std::vector<float> inverseBindMatrices(27 * 16);
+			for (int h = 0; h < 27; h++) {
+				inverseBindMatrix(desc.bindPose.position[h], desc.bindPose.rotation[h], &inverseBindMatrices[h * 16]);
+			}
+			AddAnimationView(desc, bufferBuilder, viewOpen);
+			accessorIds.inverseBindMatrices = bufferBuilder.AddAccessor(inverseBindMatrices, { TYPE_MAT4, COMPONENT_FLOAT }).id;
+
+			//Each vertex attribute in a vertex buffer view of its own, as views shared by several attributes need a
+			//byteStride, and indices in an index buffer view
+			std::vector<float> positions, weights;
+			std::vector<uint8_t> joints;
+			std::vector<uint16_t> indices;
+			CreateJointMesh(desc.bindPose, positions, joints, weights, indices);
+			JointBounds meshBounds;
+			growJointBounds(positions.data(), positions.size() / 3, &meshBounds);
+			bufferBuilder.AddBufferView(BufferViewTarget::ARRAY_BUFFER);
+			accessorIds.meshPositions = bufferBuilder.AddAccessor(positions, { TYPE_VEC3, COMPONENT_FLOAT, false,
+				std::vector<float>(meshBounds.min, meshBounds.min + 3), std::vector<float>(meshBounds.max, meshBounds.max + 3) }).id;
+			bufferBuilder.AddBufferView(BufferViewTarget::ARRAY_BUFFER);
+			accessorIds.meshJoints = bufferBuilder.AddAccessor(joints, { TYPE_VEC4, COMPONENT_UNSIGNED_BYTE }).id;
+			bufferBuilder.AddBufferView(BufferViewTarget::ARRAY_BUFFER);
+			accessorIds.meshWeights = bufferBuilder.AddAccessor(weights, { TYPE_VEC4, COMPONENT_FLOAT }).id;
+			bufferBuilder.AddBufferView(BufferViewTarget::ELEMENT_ARRAY_BUFFER);
+			accessorIds.meshIndices = bufferBuilder.AddAccessor(indices, { TYPE_SCALAR, COMPONENT_UNSIGNED_SHORT }).id;
+			viewOpen = false;
+		}
+
+		//Quantised rotations get a view of their own at the end of the buffer, so their two byte components never
+		//misalign the four byte data before them. Core glTF reads normalised int16 rotation outputs directly.
+		if (desc.quantized) {
+			viewOpen = false;
+			std::vector<int16_t> quantized;
+			for (size_t t = 0; t < takes.size(); t++) {
+				TakeAccessorIds& takeIds = accessorIds.takes[t];
+				for (int h = 0; h < 27; h++) {
+					JointChannels channels = takes[t].loadChannels(h);
+					QuantizeRotations(*channels.rotations, quantized, report.rotationErrorDegrees);
+					AddAnimationView(desc, bufferBuilder, viewOpen);
+					takeIds.rotations[h] = bufferBuilder.AddAccessor(quantized, { TYPE_VEC4, COMPONENT_SHORT, true }).id;
+					report.bytes += quantized.size() * sizeof(int16_t);
+					report.floatBytes += quantized.size() * sizeof(float);
+				}
 			}
-		}		
-		for (int i = 0; i < 27; i++) {
-			accessorIdPositions[i] = bufferBuilder.AddAccessor(positions[i], { TYPE_VEC3, COMPONENT_FLOAT, false, std::move(minValues[i]), std::move(maxValues[i]) }).id;
 		}
 
 		//Add everything created above into the document
 		bufferBuilder.Output(document);
 	}
 
-	void CreateSkeletonEntities(Document& document, const std::string& accessorIdTime, const std::string accessorIdPositions[27]) {	
-		Node skeleton[27];
+	void AddSkeletonChannel(Animation& animation, const std::string& accessorIdTime, const std::string& accessorIdOutput, const std::string& nodeId, TargetPath path, InterpolationType interpolation) {
+		AnimationSampler skeletonAnimationSampler;
+		skeletonAnimationSampler.inputAccessorId = accessorIdTime;
+		skeletonAnimationSampler.interpolation = interpolation;
+		skeletonAnimationSampler.outputAccessorId = accessorIdOutput;
+		std::string skeletonAnimationSamplerId = animation.samplers.Append(std::move(skeletonAnimationSampler), AppendIdPolicy::GenerateOnEmpty).id;
+
+		AnimationChannel skeletonAnimationChannel;
+		skeletonAnimationChannel.samplerId = skeletonAnimationSamplerId;
+		skeletonAnimationChannel.target.nodeId = nodeId;
+		skeletonAnimationChannel.target.path = path;
+		animation.channels.Append(std::move(skeletonAnimationChannel), AppendIdPolicy::GenerateOnEmpty);
+	}
+
+	//One animation per take with a channel per joint and animated property, all targeting the same joint nodes. Every
+	//linear sampler of a take reads its shared time accessor, so loaders resolve each take as a single clip. Rigged
+	//exports nest the joint nodes like the tracker's joint tree, rest them in the bind pose and skin a mesh to them.
+	void CreateSkeletonEntities(Document& document, const std::string& documentName, const GltfAnimationDesc& desc, const std::vector<GltfTake>& takes, const SkeletonAccessorIds& accessorIds) {
 		std::string skeletonId[27];
 		for (int i = 0; i < 27; i++) {
-			skeletonId[i] = document.nodes.Append(std::move(skeleton[i]), AppendIdPolicy::GenerateOnEmpty).id;
-		}		
-
-		AnimationSampler skeletonAnimationSampler[27];
-		AnimationTarget skeletonAnimationTarget[27];
-		AnimationChannel skeletonAnimationChannel[27];
-		Animation skeletonAnimation[27];
-		std::string skeletonAnimationSamplerId[27];
-		for (int i = 0; i < 27; i++) {
-			skeletonAnimationSampler[i].inputAccessorId = accessorIdTime;
-			skeletonAnimationSampler[i].outputAccessorId = accessorIdPositions[i];
-			skeletonAnimationSamplerId[i] = skeletonAnimation[i].samplers.Append(std::move(skeletonAnimationSampler[i]), AppendIdPolicy::GenerateOnEmpty).id;
-			skeletonAnimationTarget[i].nodeId = skeletonId[i];
-			skeletonAnimationTarget[i].path = TARGET_TRANSLATION;
-			skeletonAnimationChannel[i].samplerId = skeletonAnimationSamplerId[i];
-			skeletonAnimationChannel[i].target = skeletonAnimationTarget[i];			
-			skeletonAnimation[i].channels.Append(std::move(skeletonAnimationChannel[i]), AppendIdPolicy::GenerateOnEmpty);
-			document.animations.Append(std::move(skeletonAnimation[i]), AppendIdPolicy::GenerateOnEmpty); 
+			Node joint;
+			joint.name = skeletonJointNames[i];
+			if (desc.rigged) {
+				const float* t = desc.bindPose.localTranslation[i];
+				const float* r = desc.bindPose.localRotation[i];
+				joint.translation = { t[0], t[1], t[2] };
+				joint.rotation = { r[0], r[1], r[2], r[3] };
+			}
+			skeletonId[i] = document.nodes.Append(std::move(joint), AppendIdPolicy::GenerateOnEmpty).id;
+		}
+		if (desc.rigged) {
+			for (int i = 0; i < 27; i++) {
+				int parent = skeletonJointParents[i];
+				if (parent >= 0) {
+					Node parentNode = document.nodes.Get(skeletonId[parent]);
+					parentNode.children.push_back(skeletonId[i]);
+					document.nodes.Replace(parentNode);
+				}
+			}
+		}
+
+		InterpolationType interpolation = desc.splineToleranceMm > 0 ? INTERPOLATION_CUBICSPLINE : INTERPOLATION_LINEAR;
+		for (size_t t = 0; t < takes.size(); t++) {
+			const TakeAccessorIds& takeIds = accessorIds.takes[t];
+			Animation skeletonAnimation;
+			skeletonAnimation.name = takes[t].name;
+			for (int i = 0; i < 27; i++) {
+				AddSkeletonChannel(skeletonAnimation, takeIds.translationTimes[i], takeIds.translations[i], skeletonId[i], TARGET_TRANSLATION, interpolation);
+				if (desc.rigged) {
+					AddSkeletonChannel(skeletonAnimation, takeIds.rotationTimes[i], takeIds.rotations[i], skeletonId[i], TARGET_ROTATION, interpolation);
+				}
+			}
+			document.animations.Append(std::move(skeletonAnimation), AppendIdPolicy::GenerateOnEmpty);
 		}
 
 		Scene scene;
-		for (int i = 0; i < 27; i++) {
-			scene.nodes.push_back(skeletonId[i]);
+		if (desc.rigged) {
+			Skin skin;
+			skin.name = documentName;
+			skin.inverseBindMatricesAccessorId = accessorIds.inverseBindMatrices;
+			skin.jointIds.assign(skeletonId, skeletonId + 27);
+			for (int i = 0; i < 27; i++) {
+				if (skeletonJointParents[i] < 0) {
+					skin.skeletonId = skeletonId[i];
+					scene.nodes.push_back(skeletonId[i]);
+				}
+			}
+			std::string skinId = document.skins.Append(std::move(skin), AppendIdPolicy::GenerateOnEmpty).id;
+
+			MeshPrimitive primitive;
+			primitive.attributes[ACCESSOR_POSITION] = accessorIds.meshPositions;
+			primitive.attributes[ACCESSOR_JOINTS_0] = accessorIds.meshJoints;
+			primitive.attributes[ACCESSOR_WEIGHTS_0] = accessorIds.meshWeights;
+			primitive.indicesAccessorId = accessorIds.meshIndices;
+			primitive.mode = MESH_TRIANGLES;
+			Mesh mesh;
+			mesh.name = documentName;
+			mesh.primitives.push_back(std::move(primitive));
+
+			Node meshNode;
+			meshNode.name = documentName;
+			meshNode.meshId = document.meshes.Append(std::move(mesh), AppendIdPolicy::GenerateOnEmpty).id;
+			meshNode.skinId = skinId;
+			scene.nodes.push_back(document.nodes.Append(std::move(meshNode), AppendIdPolicy::GenerateOnEmpty).id);
+		}
+		else {
+			for (int i = 0; i < 27; i++) {
+				scene.nodes.push_back(skeletonId[i]);
+			}
 		}
 		document.SetDefaultScene(std::move(scene), AppendIdPolicy::GenerateOnEmpty);
 	}	
 
-	bool createGLTF(std::vector<k4abt_skeleton_t> skeletons, const char* output_path) {
+	size_t ComponentTypeSize(ComponentType componentType) {
+		switch (componentType) {
+		case COMPONENT_BYTE:
+		case COMPONENT_UNSIGNED_BYTE:
+			return 1;
+		case COMPONENT_SHORT:
+		case COMPONENT_UNSIGNED_SHORT:
+			return 2;
+		default:
+			return 4;
+		}
+	}
+
+	size_t AccessorTypeCount(AccessorType accessorType) {
+		switch (accessorType) {
+		case TYPE_VEC2:
+			return 2;
+		case TYPE_VEC3:
+			return 3;
+		case TYPE_VEC4:
+		case TYPE_MAT2:
+			return 4;
+		case TYPE_MAT3:
+			return 9;
+		case TYPE_MAT4:
+			return 16;
+		default:
+			return 1;
+		}
+	}
+
+	//Moves the untargeted views of a buffer built in memory into a compressed buffer under EXT_meshopt_compression and
+	//copies vertex and index views as they are. Compressed views keep their layout in a fallback buffer without data,
+	//padded to whole elements of a stride the codec accepts: six byte int16 triples are encoded two at a time.
+	//Every view is decoded again and compared before it is kept. Fills data with the buffer to write.
+	bool CompressAnimationViews(Document& document, const std::string& bufferId, bool binary, const std::string& uncompressed, const ResourceWriter& writer, std::vector<uint8_t>& data, ChannelReport& report) {
+		const std::string fallbackId = bufferId + "_fallback";
+		std::unordered_map<std::string, size_t> elementSizes;
+		for (size_t i = 0; i < document.accessors.Size(); i++) {
+			const Accessor& accessor = document.accessors.Get(i);
+			elementSizes[accessor.bufferViewId] = ComponentTypeSize(accessor.componentType) * AccessorTypeCount(accessor.type);
+		}
+
+		size_t bufferIndex = document.buffers.GetIndex(bufferId);
+		size_t fallbackLength = 0;
+		std::vector<uint8_t> padded, encoded, decoded;
+		for (size_t i = 0; i < document.bufferViews.Size(); i++) {
+			BufferView view = document.bufferViews.Get(i);
+			const uint8_t* source = (const uint8_t*)uncompressed.data() + view.byteOffset;
+			data.resize((data.size() + 3) & ~(size_t)3, 0);
+			if (view.target.HasValue()) {
+				view.byteOffset = data.size();
+				data.insert(data.end(), source, source + view.byteLength);
+				document.bufferViews.Replace(view);
+				continue;
+			}
+
+			size_t elementSize = std::max(elementSizes[view.id], (size_t)1);
+			size_t stride = elementSize % 4 == 0 ? elementSize : elementSize % 2 == 0 ? elementSize * 2 : elementSize * 4;
+			size_t count = (view.byteLength + stride - 1) / stride;
+			padded.assign(source, source + view.byteLength);
+			padded.resize(count * stride, 0);
+			meshoptEncodeAttributes(padded.data(), count, stride, &encoded);
+			decoded.resize(padded.size());
+			if (meshoptDecodeAttributes(encoded.data(), encoded.size(), count, stride, decoded.data()) != "" || decoded != padded) {
+				std::cout << "Meshopt round trip failed for buffer view " << view.id << "." << std::endl;
+				return false;
+			}
+
+			std::ostringstream extension;
+			extension << "{\"buffer\":" << bufferIndex << ",\"byteOffset\":" << data.size() << ",\"byteLength\":" << encoded.size()
+				<< ",\"byteStride\":" << stride << ",\"count\":" << count << ",\"mode\":\"ATTRIBUTES\"}";
+			data.insert(data.end(), encoded.begin(), encoded.end());
+			fallbackLength = (fallbackLength + 3) & ~(size_t)3;
+			view.bufferId = fallbackId;
+			view.byteOffset = fallbackLength;
+			view.byteLength = count * stride;
+			view.extensions["EXT_meshopt_compression"] = extension.str();
+			fallbackLength += view.byteLength;
+			document.bufferViews.Replace(view);
+			report.compressedBytes += encoded.size();
+			report.uncompressedBytes += view.byteLength;
+		}
+
+		Buffer buffer = document.buffers.Get(bufferId);
+		buffer.byteLength = data.size();
+		buffer.uri = binary ? "" : writer.GenerateBufferUri(bufferId);
+		document.buffers.Replace(buffer);
+		Buffer fallback;
+		fallback.id = fallbackId;
+		fallback.byteLength = fallbackLength;
+		fallback.extensions["EXT_meshopt_compression"] = "{\"fallback\":true}";
+		document.buffers.Append(std::move(fallback));
+
+		//The fallback buffer holds no data, so readers without the extension must refuse the file
+		document.extensionsUsed.insert("EXT_meshopt_compression");
+		document.extensionsRequired.insert("EXT_meshopt_compression");
+		return true;
+	}
+
+	//Writes a glTF document with one animation per take over a single set of joint nodes and a single buffer.
+	//A .glb output_path writes a single binary file with a compact manifest, anything else a pretty printed manifest
+	//and a .bin buffer. Accessors need at least one element, so takes without frames are refused before anything
+	//is written.
+	bool createGLTF(const GltfAnimationDesc& desc, const std::vector<GltfTake>& takes, const char* output_path) {
+		for (size_t t = 0; t < takes.size(); t++) {
+			if (takes[t].frameCount == 0) {
+				std::cout << "Take " << takes[t].name << " has no frames." << std::endl;
+				return false;
+			}
+		}
 		bool result = true;
+		bool binary = std::experimental::filesystem::path(output_path).extension() == ".glb";
 
 		//Convert output_path to absolute path
 		std::experimental::filesystem::path path = output_path;
@@ -147,33 +642,141 @@ namespace {
 		//Create file writers
 		auto streamWriter = std::make_unique<StreamWriter>(path.parent_path());
 		std::experimental::filesystem::path pathFile = path.filename();
-		std::unique_ptr<ResourceWriter> resourceWriter = std::make_unique<GLTFResourceWriter>(std::move(streamWriter));
+		std::unique_ptr<ResourceWriter> resourceWriter, bufferWriter;
+		if (binary) {
+			resourceWriter = std::make_unique<GLBResourceWriter>(std::move(streamWriter));
+		}
+		else {
+			resourceWriter = std::make_unique<GLTFResourceWriter>(std::move(streamWriter));
+		}
+
+		//Meshopt exports build the buffer in memory and write it once it is compressed
+		ResourceWriter& outputWriter = *resourceWriter;
+		MemoryStreamWriter* memoryStream = NULL;
+		if (desc.meshopt) {
+			auto memoryWriter = std::make_unique<MemoryStreamWriter>();
+			memoryStream = memoryWriter.get();
+			bufferWriter = std::make_unique<GLTFResourceWriter>(std::move(memoryWriter));
+		}
+		else {
+			bufferWriter = std::move(resourceWriter);
+		}
 
 		//Create gltf JSON manifest
 		Document document;
-		std::string accessorIdTime;
-		std::string accessorIdPositions[27];
-		BufferBuilder bufferBuilder(std::move(resourceWriter));
+		SkeletonAccessorIds accessorIds;
+		ChannelReport report;
+		std::string bufferId = binary ? GLB_BUFFER_ID : fileName;
+		BufferBuilder bufferBuilder(std::move(bufferWriter));
 
 		//Create gltf assets
-		CreateSkeletonResources(skeletons, fileName, document, bufferBuilder, accessorIdTime, accessorIdPositions);
-		CreateSkeletonEntities(document, accessorIdTime, accessorIdPositions);
+		CreateSkeletonResources(desc, takes, bufferId, document, bufferBuilder, accessorIds, report);
+		CreateSkeletonEntities(document, fileName, desc, takes, accessorIds);
+
+		if (desc.meshopt) {
+			std::vector<uint8_t> data;
+			if (!CompressAnimationViews(document, bufferId, binary, memoryStream->contents(), outputWriter, data, report)) {
+				return false;
+			}
+			BufferView dataView;
+			dataView.bufferId = bufferId;
+			dataView.byteLength = data.size();
+			outputWriter.Write(dataView, data.data());
+		}
 
 		// Serialize the glTF Document into a JSON manifest
 		std::string manifest;
 		try	{			
-			manifest = Serialize(document, SerializeFlags::Pretty);
+			manifest = Serialize(document, binary ? SerializeFlags::None : SerializeFlags::Pretty);
 		}
 		catch (const GLTFException& ex) {
 			std::cout << ex.what() << std::endl;
 			result = false;
 		}
 
-		//Write the JSON manifest to file
-		auto& gltfResourceWriter = bufferBuilder.GetResourceWriter();
-		gltfResourceWriter.WriteExternal(pathFile.u8string(), manifest.c_str(), manifest.length());
+		//Write the JSON manifest to file, a GLB gets the manifest and the buffer in one file
+		if (binary) {
+			auto& glbResourceWriter = static_cast<GLBResourceWriter&>(outputWriter);
+			glbResourceWriter.Flush(manifest, pathFile.u8string());
+		}
+		else {
+			outputWriter.WriteExternal(pathFile.u8string(), manifest.c_str(), manifest.length());
+		}
 
+		if (result && (desc.quantized || desc.splineToleranceMm > 0)) {
+			std::cout << (desc.quantized ? "Quantised animation: " : "Spline animation: ");
+			if (report.frameKeys > 0) {
+				std::cout << report.keys << " keys instead of " << report.frameKeys << ", ";
+			}
+			if (desc.quantized) {
+				std::cout << report.bytes << " bytes of rotations instead of " << report.floatBytes << ", max error " << report.rotationErrorDegrees << " degrees";
+			}
+			else {
+				std::cout << report.bytes << " bytes instead of " << report.floatBytes << ", max error " << report.translationErrorMm << " mm";
+				if (desc.rigged) {
+					std::cout << " and " << report.rotationErrorDegrees << " degrees";
+				}
+			}
+			std::cout << std::endl;
+		}
+		if (result && desc.meshopt) {
+			std::cout << "Meshopt animation: " << report.compressedBytes << " bytes instead of " << report.uncompressedBytes << " ("
+				<< (double)report.uncompressedBytes / std::max(report.compressedBytes, (size_t)1) << "x)" << std::endl;
+		}
 		return result;
 	}
+
+	//Writes tracks held in memory as takes named takeNames, rigged and quantised if the options ask for it.
+	//Rigged documents are bound to the first frame of the first take.
+	bool createGLTF(const std::vector<std::string>& takeNames, const std::vector<const SkeletonTrack*>& tracks, const char* output_path, const GltfExportOptions& options) {
+		GltfAnimationDesc desc;
+		applyGltfExportOptions(options, &desc);
+		std::vector<GltfTake> takes(tracks.size());
+		for (size_t t = 0; t < tracks.size(); t++) {
+			takes[t].name = takeNames[t];
+			takes[t].frameCount = tracks[t]->size();
+		}
+		if (!desc.rigged) {
+			for (size_t t = 0; t < tracks.size(); t++) {
+				const SkeletonTrack& track = *tracks[t];
+				computeJointBounds(track, takes[t].bounds);
+				takes[t].loadChannels = [&track](int joint) {
+					JointChannels channels;
+					channels.translations = &track.positions(joint);
+					return channels;
+				};
+			}
+			return createGLTF(desc, takes, output_path);
+		}
+
+		//Each take gets its own pose builder so its rotations start in their own hemisphere
+		std::vector<std::vector<float>> translations(tracks.size() * 27), rotations(tracks.size() * 27);
+		for (size_t t = 0; t < tracks.size(); t++) {
+			std::vector<float>* takeTranslations = &translations[t * 27];
+			std::vector<float>* takeRotations = &rotations[t * 27];
+			LocalPoseBuilder poseBuilder;
+			poseBuilder.append(*tracks[t], takeTranslations, takeRotations);
+			if (!desc.bindPose.valid) {
+				desc.bindPose = poseBuilder.bindPose();
+			}
+			for (int h = 0; h < 27; h++) {
+				growJointBounds(takeTranslations[h].data(), tracks[t]->size(), &takes[t].bounds[h]);
+			}
+			takes[t].loadChannels = [takeTranslations, takeRotations](int joint) {
+				JointChannels channels;
+				channels.translations = &takeTranslations[joint];
+				channels.rotations = &takeRotations[joint];
+				return channels;
+			};
+		}
+		return createGLTF(desc, takes, output_path);
+	}
+
+	//Writes a whole track held in memory as a single take named after the output file
+	bool createGLTF(const SkeletonTrack& track, const char* output_path, const GltfExportOptions& options) {
+		std::vector<std::string> takeNames(1U, std::experimental::filesystem::path(output_path).stem().string());
+		std::vector<const SkeletonTrack*> tracks(1U, &track);
+		return createGLTF(takeNames, tracks, output_path, options);
+	}
 }
 
@@ -0,0 +1,495 @@
+#pragma once
+
+#include <GLTFSDK/GLTF.h>
+#include <GLTFSDK/GLTFResourceReader.h>
+#include <GLTFSDK/GLBResourceReader.h>
+#include <GLTFSDK/Deserialize.h>
+#include <GLTFSDK/IStreamReader.h>
+
+#include "gltfFunctions.h"
+#include "skeletonTrackFunctions.h"
+#include "splineFitFunctions.h"
+#include "meshoptFunctions.h"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace Microsoft::glTF;
+
+namespace {
+
+	class StreamReader : public IStreamReader
+	{
+	public:
+		StreamReader(std::experimental::filesystem::path pathBase) : m_pathBase(std::move(pathBase))
+		{
+		}
+
+		//Resolves the relative URIs of the manifest and any external buffers it declares
+		std::shared_ptr<std::istream> GetInputStream(const std::string& filename) const override
+		{
+			auto streamPath = m_pathBase / std::experimental::filesystem::u8path(filename);
+			auto stream = std::make_shared<std::ifstream>(streamPath, std::ios_base::binary);
+
+			//Check if the stream has no errors and is ready for I/O operations
+			if (!stream || !(*stream))
+			{
+				throw std::runtime_error("Unable to create a valid input stream for uri: " + filename);
+			}
+
+			return stream;
+		}
+
+	private:
+		std::experimental::filesystem::path m_pathBase;
+	};
+
+	//Reads an unsigned number member of a flat JSON object such as an unregistered extension, false if it is missing
+	bool JsonSize(const std::string& json, const std::string& key, size_t* value) {
+		size_t position = json.find("\"" + key + "\"");
+		if (position == std::string::npos) {
+			return false;
+		}
+		position = json.find(':', position);
+		if (position == std::string::npos) {
+			return false;
+		}
+		*value = (size_t)std::strtoull(json.c_str() + position + 1, NULL, 10);
+		return true;
+	}
+
+	//Buffer views read so far, decoded if they were compressed, so accessors sharing a view only read it once
+	typedef std::unordered_map<std::string, std::vector<uint8_t>> ViewCache;
+
+	std::string ReadViewBytes(const Document& document, const GLTFResourceReader& reader, const std::string& viewId, ViewCache& cache, const std::vector<uint8_t>** bytes) {
+		auto cached = cache.find(viewId);
+		if (cached != cache.end()) {
+			*bytes = &cached->second;
+			return "";
+		}
+		const BufferView& view = document.bufferViews.Get(viewId);
+		std::vector<uint8_t>& data = cache[viewId];
+		auto extension = view.extensions.find("EXT_meshopt_compression");
+		if (extension == view.extensions.end()) {
+			data = reader.ReadBinaryData<uint8_t>(document, view);
+		}
+		else {
+			//The view's own buffer is a fallback without data, the extension points at the compressed stream
+			const std::string& json = extension->second;
+			size_t bufferIndex, byteOffset = 0, byteLength, byteStride, count;
+			if (!JsonSize(json, "buffer", &bufferIndex) || !JsonSize(json, "byteLength", &byteLength) || !JsonSize(json, "byteStride", &byteStride) || !JsonSize(json, "count", &count)) {
+				return "Invalid EXT_meshopt_compression in buffer view " + viewId + ".\n";
+			}
+			JsonSize(json, "byteOffset", &byteOffset);
+			if (json.find("\"ATTRIBUTES\"") == std::string::npos || (json.find("\"filter\"") != std::string::npos && json.find("\"NONE\"") == std::string::npos)) {
+				return "Only unfiltered EXT_meshopt_compression attribute streams can be imported.\n";
+			}
+			if (bufferIndex >= document.buffers.Size()) {
+				return "Invalid EXT_meshopt_compression buffer in buffer view " + viewId + ".\n";
+			}
+			BufferView source;
+			source.bufferId = document.buffers.Get(bufferIndex).id;
+			source.byteOffset = byteOffset;
+			source.byteLength = byteLength;
+			std::vector<uint8_t> encoded = reader.ReadBinaryData<uint8_t>(document, source);
+			data.resize(count * byteStride);
+			std::string errorMessage = meshoptDecodeAttributes(encoded.data(), encoded.size(), count, byteStride, data.data());
+			if (errorMessage != "") {
+				return errorMessage;
+			}
+		}
+		*bytes = &data;
+		return "";
+	}
+
+	//Reads an accessor as floats, width per element, undoing integer normalisation
+	std::string ReadAccessorFloats(const Document& document, const GLTFResourceReader& reader, const std::string& accessorId, ViewCache& cache, std::vector<float>* values) {
+		const Accessor& accessor = document.accessors.Get(accessorId);
+		const std::vector<uint8_t>* bytes = NULL;
+		std::string errorMessage = ReadViewBytes(document, reader, accessor.bufferViewId, cache, &bytes);
+		if (errorMessage != "") {
+			return errorMessage;
+		}
+		const BufferView& view = document.bufferViews.Get(accessor.bufferViewId);
+		size_t width = AccessorTypeCount(accessor.type);
+		size_t componentSize = ComponentTypeSize(accessor.componentType);
+		size_t stride = view.byteStride.HasValue() ? view.byteStride.Get() : width * componentSize;
+		if (accessor.count > 0 && accessor.byteOffset + (accessor.count - 1) * stride + width * componentSize > bytes->size()) {
+			return "Accessor " + accessorId + " is out of range of its buffer view.\n";
+		}
+
+		values->resize(accessor.count * width);
+		for (size_t i = 0; i < accessor.count; i++) {
+			const uint8_t* element = bytes->data() + accessor.byteOffset + i * stride;
+			for (size_t c = 0; c < width; c++) {
+				const uint8_t* component = element + c * componentSize;
+				float value = 0;
+				switch (accessor.componentType) {
+				case COMPONENT_FLOAT:
+					std::memcpy(&value, component, sizeof(float));
+					break;
+				case COMPONENT_SHORT: {
+					int16_t v;
+					std::memcpy(&v, component, sizeof(v));
+					value = accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v;
+					break;
+				}
+				case COMPONENT_UNSIGNED_SHORT: {
+					uint16_t v;
+					std::memcpy(&v, component, sizeof(v));
+					value = accessor.normalized ? v / 65535.0f : v;
+					break;
+				}
+				case COMPONENT_BYTE: {
+					int8_t v = (int8_t)*component;
+					value = accessor.normalized ? std::max(v / 127.0f, -1.0f) : v;
+					break;
+				}
+				case COMPONENT_UNSIGNED_BYTE:
+					value = accessor.normalized ? *component / 255.0f : *component;
+					break;
+				default:
+					return "Accessor " + accessorId + " has an unsupported component type.\n";
+				}
+				(*values)[i * width + c] = value;
+			}
+		}
+		return "";
+	}
+
+	//Keys of one animation sampler, with in-tangent, value and out-tangent per key for cubic splines
+	struct ImportSampler {
+		std::vector<float> times;
+		std::vector<float> values;
+		int width = 0;
+		InterpolationType interpolation = INTERPOLATION_LINEAR;
+	};
+
+	void SlerpQuaternion(const float* a, const float* b, float s, float* out) {
+		float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+		float sign = dot < 0 ? -1.0f : 1.0f;
+		dot *= sign;
+		float wa = 1 - s, wb = s * sign;
+		if (dot < 0.9995f) {
+			float angle = std::acos(dot);
+			wa = std::sin((1 - s) * angle) / std::sin(angle);
+			wb = sign * std::sin(s * angle) / std::sin(angle);
+		}
+		for (int c = 0; c < 4; c++) {
+			out[c] = wa * a[c] + wb * b[c];
+		}
+	}
+
+	//Evaluates a sampler at time seconds like a glTF runtime, holding the first and last keys outside their range
+	void EvaluateSampler(const ImportSampler& sampler, double seconds, bool rotation, float* out) {
+		int width = sampler.width;
+		bool cubic = sampler.interpolation == INTERPOLATION_CUBICSPLINE;
+		auto value = [&](size_t key) {
+			return &sampler.values[(cubic ? key * 3 + 1 : key) * width];
+		};
+		size_t next = std::upper_bound(sampler.times.begin(), sampler.times.end(), (float)seconds) - sampler.times.begin();
+		if (next == 0 || next == sampler.times.size() || sampler.interpolation == INTERPOLATION_STEP) {
+			std::memcpy(out, value(next == 0 ? 0 : next - 1), width * sizeof(float));
+		}
+		else {
+			size_t key = next - 1;
+			double duration = sampler.times[next] - sampler.times[key];
+			double s = duration > 0 ? (seconds - sampler.times[key]) / duration : 0;
+			if (cubic) {
+				double h00, h10, h01, h11;
+				hermiteBasis(s, &h00, &h10, &h01, &h11);
+				const float* outTangent = &sampler.values[(key * 3 + 2) * width];
+				const float* inTangent = &sampler.values[(next * 3) * width];
+				for (int c = 0; c < width; c++) {
+					out[c] = (float)(h00 * value(key)[c] + h10 * duration * outTangent[c] + h01 * value(next)[c] + h11 * duration * inTangent[c]);
+				}
+			}
+			else if (rotation) {
+				SlerpQuaternion(value(key), value(next), (float)s, out);
+			}
+			else {
+				for (int c = 0; c < width; c++) {
+					out[c] = (float)(value(key)[c] + s * (value(next)[c] - value(key)[c]));
+				}
+			}
+		}
+		if (rotation) {
+			float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3]);
+			for (int c = 0; c < 4 && length > 0; c++) {
+				out[c] /= length;
+			}
+		}
+	}
+
+	//Translation, rotation (xyzw) and scale of a node, or the static matrix it was given instead
+	struct ImportNodePose {
+		float translation[3] = { 0, 0, 0 };
+		float rotation[4] = { 0, 0, 0, 1 };
+		float scale[3] = { 1, 1, 1 };
+		bool hasMatrix = false;
+		float matrix[16];
+	};
+
+	//Column-major local matrix of a pose
+	void PoseMatrix(const ImportNodePose& pose, float* matrix) {
+		if (pose.hasMatrix) {
+			std::memcpy(matrix, pose.matrix, 16 * sizeof(float));
+			return;
+		}
+		float x = pose.rotation[0], y = pose.rotation[1], z = pose.rotation[2], w = pose.rotation[3];
+		float r[3][3] = {
+			{ 1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w) },
+			{ 2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w) },
+			{ 2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y) }
+		};
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				matrix[column * 4 + row] = r[column][row] * pose.scale[column];
+			}
+			matrix[column * 4 + 3] = 0;
+		}
+		for (int row = 0; row < 3; row++) {
+			matrix[12 + row] = pose.translation[row];
+		}
+		matrix[15] = 1;
+	}
+
+	void MultiplyMatrices(const float* a, const float* b, float* out) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				float sum = 0;
+				for (int k = 0; k < 4; k++) {
+					sum += a[k * 4 + row] * b[column * 4 + k];
+				}
+				out[column * 4 + row] = sum;
+			}
+		}
+	}
+
+	//Rotation of a world matrix as wxyz, with any scale divided out of its columns first
+	void MatrixOrientation(const float* matrix, float* wxyz) {
+		float r[3][3];
+		for (int column = 0; column < 3; column++) {
+			const float* c = &matrix[column * 4];
+			float length = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+			for (int row = 0; row < 3; row++) {
+				r[row][column] = length > 0 ? c[row] / length : (row == column ? 1.0f : 0.0f);
+			}
+		}
+		float trace = r[0][0] + r[1][1] + r[2][2];
+		float w, x, y, z;
+		if (trace > 0) {
+			float s = std::sqrt(trace + 1) * 2;
+			w = s / 4;
+			x = (r[2][1] - r[1][2]) / s;
+			y = (r[0][2] - r[2][0]) / s;
+			z = (r[1][0] - r[0][1]) / s;
+		}
+		else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+			float s = std::sqrt(1 + r[0][0] - r[1][1] - r[2][2]) * 2;
+			w = (r[2][1] - r[1][2]) / s;
+			x = s / 4;
+			y = (r[0][1] + r[1][0]) / s;
+			z = (r[0][2] + r[2][0]) / s;
+		}
+		else if (r[1][1] > r[2][2]) {
+			float s = std::sqrt(1 + r[1][1] - r[0][0] - r[2][2]) * 2;
+			w = (r[0][2] - r[2][0]) / s;
+			x = (r[0][1] + r[1][0]) / s;
+			y = s / 4;
+			z = (r[1][2] + r[2][1]) / s;
+		}
+		else {
+			float s = std::sqrt(1 + r[2][2] - r[0][0] - r[1][1]) * 2;
+			w = (r[1][0] - r[0][1]) / s;
+			x = (r[0][2] + r[2][0]) / s;
+			y = (r[1][2] + r[2][1]) / s;
+			z = s / 4;
+		}
+		float sign = w < 0 ? -1.0f : 1.0f;
+		wxyz[0] = sign * w;
+		wxyz[1] = sign * x;
+		wxyz[2] = sign * y;
+		wxyz[3] = sign * z;
+	}
+
+	//Resamples every animation of a document at IMPORT_FRAME_RATE into the global joint poses of the skeleton. Joint
+	//nodes are found by name and posed through every node above them, so extra parent nodes, the rigged hierarchy
+	//and splines are undone by evaluating the scene the way a viewer would.
+	std::string ReadSkeletonTakes(const Document& document, const GLTFResourceReader& reader, std::vector<SkeletonTake>* takes) {
+		size_t nodeCount = document.nodes.Size();
+		std::vector<ImportNodePose> restPoses(nodeCount);
+		std::vector<int> parents(nodeCount, -1);
+		int jointNodes[SKELETON_JOINT_COUNT];
+		std::fill(jointNodes, jointNodes + SKELETON_JOINT_COUNT, -1);
+		for (size_t i = 0; i < nodeCount; i++) {
+			const Node& node = document.nodes.Get(i);
+			ImportNodePose& pose = restPoses[i];
+			pose.translation[0] = node.translation.x; pose.translation[1] = node.translation.y; pose.translation[2] = node.translation.z;
+			pose.rotation[0] = node.rotation.x; pose.rotation[1] = node.rotation.y; pose.rotation[2] = node.rotation.z; pose.rotation[3] = node.rotation.w;
+			pose.scale[0] = node.scale.x; pose.scale[1] = node.scale.y; pose.scale[2] = node.scale.z;
+			pose.hasMatrix = node.matrix.values != Matrix4::IDENTITY.values;
+			std::copy(node.matrix.values.begin(), node.matrix.values.end(), pose.matrix);
+			for (size_t c = 0; c < node.children.size(); c++) {
+				parents[document.nodes.GetIndex(node.children[c])] = (int)i;
+			}
+			for (int j = 0; j < SKELETON_JOINT_COUNT && node.meshId.empty(); j++) {
+				if (node.name == skeletonJointNames[j]) {
+					jointNodes[j] = (int)i;
+				}
+			}
+		}
+		for (int j = 0; j < SKELETON_JOINT_COUNT; j++) {
+			if (jointNodes[j] < 0) {
+				return std::string("No node for joint ") + skeletonJointNames[j] + ", the file is not a skeleton export.\n";
+			}
+		}
+
+		//Joints and every node above them, ancestors first
+		std::vector<int> order;
+		std::vector<bool> ordered(nodeCount, false);
+		for (int j = 0; j < SKELETON_JOINT_COUNT; j++) {
+			std::vector<int> chain;
+			for (int n = jointNodes[j]; n >= 0 && !ordered[n]; n = parents[n]) {
+				chain.push_back(n);
+				ordered[n] = true;
+			}
+			order.insert(order.end(), chain.rbegin(), chain.rend());
+		}
+
+		ViewCache cache;
+		for (size_t a = 0; a < document.animations.Size(); a++) {
+			const Animation& animation = document.animations.Get(a);
+			std::vector<ImportSampler> samplers(animation.samplers.Size());
+			std::vector<size_t> channelSamplers(animation.channels.Size()), channelNodes(animation.channels.Size());
+			for (size_t c = 0; c < animation.channels.Size(); c++) {
+				const AnimationChannel& channel = animation.channels.Get(c);
+				channelSamplers[c] = animation.samplers.GetIndex(channel.samplerId);
+				channelNodes[c] = document.nodes.GetIndex(channel.target.nodeId);
+			}
+			double duration = 0;
+			for (size_t s = 0; s < animation.samplers.Size(); s++) {
+				const AnimationSampler& source = animation.samplers.Get(s);
+				ImportSampler& sampler = samplers[s];
+				std::string errorMessage = ReadAccessorFloats(document, reader, source.inputAccessorId, cache, &sampler.times);
+				if (errorMessage == "") {
+					errorMessage = ReadAccessorFloats(document, reader, source.outputAccessorId, cache, &sampler.values);
+				}
+				if (errorMessage != "") {
+					return errorMessage;
+				}
+				sampler.interpolation = source.interpolation;
+				size_t keys = sampler.times.size() * (sampler.interpolation == INTERPOLATION_CUBICSPLINE ? 3 : 1);
+				sampler.width = keys > 0 ? (int)(sampler.values.size() / keys) : 0;
+				if (!sampler.times.empty()) {
+					duration = std::max(duration, (double)sampler.times.back());
+				}
+			}
+
+			SkeletonTake take;
+			take.name = animation.name;
+			size_t frameCount = (size_t)std::floor(duration * IMPORT_FRAME_RATE + 0.5) + 1;
+			take.track.reserve(frameCount);
+			std::vector<ImportNodePose> poses;
+			std::vector<float> worlds(nodeCount * 16);
+			float local[16];
+			for (size_t frame = 0; frame < frameCount; frame++) {
+				double seconds = (double)frame / IMPORT_FRAME_RATE;
+				poses = restPoses;
+				for (size_t c = 0; c < animation.channels.Size(); c++) {
+					const AnimationChannel& channel = animation.channels.Get(c);
+					const ImportSampler& sampler = samplers[channelSamplers[c]];
+					ImportNodePose& pose = poses[channelNodes[c]];
+					if (sampler.times.empty()) {
+						continue;
+					}
+					if (channel.target.path == TARGET_TRANSLATION && sampler.width == 3) {
+						EvaluateSampler(sampler, seconds, false, pose.translation);
+					}
+					else if (channel.target.path == TARGET_ROTATION && sampler.width == 4) {
+						EvaluateSampler(sampler, seconds, true, pose.rotation);
+					}
+					else if (channel.target.path == TARGET_SCALE && sampler.width == 3) {
+						EvaluateSampler(sampler, seconds, false, pose.scale);
+					}
+				}
+				for (size_t o = 0; o < order.size(); o++) {
+					int n = order[o];
+					PoseMatrix(poses[n], local);
+					if (parents[n] < 0) {
+						std::memcpy(&worlds[n * 16], local, sizeof(local));
+					}
+					else {
+						MultiplyMatrices(&worlds[parents[n] * 16], local, &worlds[n * 16]);
+					}
+				}
+
+				k4abt_skeleton_t skeleton = k4abt_skeleton_t();
+				for (int j = 0; j < SKELETON_JOINT_COUNT; j++) {
+					const float* world = &worlds[jointNodes[j] * 16];
+					k4abt_joint_t& joint = skeleton.joints[j];
+					joint.position.xyz.x = world[12];
+					joint.position.xyz.y = world[13];
+					joint.position.xyz.z = world[14];
+					float wxyz[4];
+					MatrixOrientation(world, wxyz);
+					joint.orientation.wxyz.w = wxyz[0];
+					joint.orientation.wxyz.x = wxyz[1];
+					joint.orientation.wxyz.y = wxyz[2];
+					joint.orientation.wxyz.z = wxyz[3];
+					joint.confidence_level = IMPORT_JOINT_CONFIDENCE;
+				}
+				take.track.append(skeleton, (uint64_t)(frame * 1000000 / IMPORT_FRAME_RATE));
+			}
+			takes->push_back(std::move(take));
+		}
+		return "";
+	}
+}
+
+//Reads every animation of a .gltf or .glb file written by createGLTF back into a take of the same name. Rigged,
+//quantised, spline and meshopt compressed exports are all read, as are other files whose joint nodes carry the
+//exported joint names. Orientations are only meaningful for rigged exports.
+std::string readGLTF(const char* input_path, std::vector<SkeletonTake>* takes) {
+	std::experimental::filesystem::path path = input_path;
+	if (path.is_relative()) {
+		path = std::experimental::filesystem::current_path() / path;
+	}
+	std::experimental::filesystem::path pathFile = path.filename();
+	try {
+		auto streamReader = std::make_unique<StreamReader>(path.parent_path());
+		std::unique_ptr<GLTFResourceReader> resourceReader;
+		std::string manifest;
+		if (path.extension() == ".glb") {
+			auto glbStream = streamReader->GetInputStream(pathFile.u8string());
+			auto glbResourceReader = std::make_unique<GLBResourceReader>(std::move(streamReader), std::move(glbStream));
+			manifest = glbResourceReader->GetJson();
+			resourceReader = std::move(glbResourceReader);
+		}
+		else {
+			auto gltfStream = streamReader->GetInputStream(pathFile.u8string());
+			std::stringstream manifestStream;
+			manifestStream << gltfStream->rdbuf();
+			manifest = manifestStream.str();
+			resourceReader = std::make_unique<GLTFResourceReader>(std::move(streamReader));
+		}
+
+		Document document = Deserialize(manifest);
+		std::string errorMessage = ReadSkeletonTakes(document, *resourceReader, takes);
+		if (errorMessage == "" && takes->empty()) {
+			errorMessage = "The file has no animations.\n";
+		}
+		return errorMessage;
+	}
+	catch (const std::exception& ex) {
+		return std::string("Failed to read glTF: ") + ex.what() + "\n";
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "fbxFunctions.h"
+#include "gltfImportFunctions.h"
+#include "checkerFunctions.h"
+#include "profilerFunctions.h"
+#include "skeletonTrackFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonCodecFunctions.h"
+
+#include <string>
+#include <vector>
+#include <experimental/filesystem>
+
+//Reads a FBX, GLTF, GLB, SKEL or compressed SKELZ file back into skeleton tracks depending on the input extension.
+//FBX and glTF files give one take per animation named after it, skeleton files a single take named after the file.
+std::string importSkeletons(const char* input_path, std::vector<SkeletonTake>* takes) {
+	std::string errorMessage = "";
+	ScopedTimer importTimer(STAGE_IMPORT);
+	if (hasExtension(input_path, ".fbx")) {
+		errorMessage += readFBX(input_path, takes);
+	}
+	else if (hasExtension(input_path, ".gltf") || outputGLB(input_path)) {
+		errorMessage += readGLTF(input_path, takes);
+	}
+	else if (outputSKEL(input_path) || outputSKELZ(input_path)) {
+		SkeletonTake take;
+		take.name = std::experimental::filesystem::path(input_path).stem().string();
+		if (outputSKELZ(input_path)) {
+			errorMessage += readSkelzFile(input_path, &take.track);
+		}
+		else {
+			SkelFileReader reader;
+			errorMessage += reader.open(input_path);
+			if (errorMessage == "") {
+				reader.readAll(&take.track);
+			}
+		}
+		if (errorMessage == "" && take.track.empty()) {
+			errorMessage += "Skeleton file has no frames.\n";
+		}
+		if (errorMessage == "") {
+			takes->push_back(std::move(take));
+		}
+	}
+	else {
+		errorMessage += "Invalid input type, use .fbx, .gltf, .glb, .skel or .skelz.\n";
+	}
+	return errorMessage;
+}
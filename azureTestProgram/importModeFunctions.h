@@ -0,0 +1,57 @@
+#pragma once
+
+#include "exportFunctions.h"
+#include "importFunctions.h"
+#include "checkerFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+//Converts an exported FBX or glTF file, or a skeleton file, to another output without the tracker or the sensor.
+//takeName selects one animation of the input, an empty name keeps every take for glTF outputs and the first take
+//for outputs that hold a single recording.
+std::string importModeFunction(const char* input_path, const char* output_path, const ExportOptions& options, const std::string& takeName = "") {
+	//Check output file existence
+	if (fileExists(output_path)) {
+		return "Output file already exists, please choose another name.\n";
+	}
+
+	std::vector<SkeletonTake> takes;
+	std::string errorMessage = importSkeletons(input_path, &takes);
+	if (errorMessage != "") {
+		return errorMessage;
+	}
+	for (size_t t = 0; t < takes.size(); t++) {
+		std::cout << "Read take " << takes[t].name << ", " << takes[t].track.size() << " frames" << std::endl;
+	}
+	if (takeName != "") {
+		size_t t = 0;
+		while (t < takes.size() && takes[t].name != takeName) {
+			t++;
+		}
+		if (t == takes.size()) {
+			return "No take named " + takeName + " in the input.\n";
+		}
+		takes.erase(takes.begin() + t + 1, takes.end());
+		takes.erase(takes.begin(), takes.begin() + t);
+	}
+
+	//Every take fits in one glTF, other outputs get the first
+	if (takes.size() > 1 && (outputGLTF(output_path) || outputGLB(output_path))) {
+		std::vector<std::string> takeNames;
+		std::vector<const SkeletonTrack*> tracks;
+		for (size_t t = 0; t < takes.size(); t++) {
+			takeNames.push_back(takes[t].name);
+			tracks.push_back(&takes[t].track);
+		}
+		createOutputDirectory(output_path);
+		ScopedTimer exportTimer(STAGE_EXPORT);
+		return createGLTF(takeNames, tracks, output_path, options.gltf) ? "" : "An error occurred while creating the gltf.\n";
+	}
+	if (takes.size() > 1) {
+		std::cout << "Exporting take " << takes[0].name << " of " << takes.size() << ", choose another with -take" << std::endl;
+	}
+	return exportSkeletons(takes[0].track, output_path, options);
+}
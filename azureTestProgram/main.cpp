@@ -10,16 +10,41 @@
 #include "streamModeFunctions.h"
 #include "imageModeFunctions.h"
 #include "videoModeFunctions.h"
+#include "batchModeFunctions.h"
+#include "syntheticModeFunctions.h"
+#include "replayModeFunctions.h"
+#include "exportModeFunctions.h"
+#include "takesModeFunctions.h"
+#include "importModeFunctions.h"
+#include "recoverModeFunctions.h"
+#include "codecBenchModeFunctions.h"
+#include "gltfBenchModeFunctions.h"
+#include "profilerFunctions.h"
 
-//Syntax: azureProgram.exe -mode (input.mkv) (output.___)
+//Syntax: azureProgram.exe -mode (input.mkv) (output.___) (-options)
 	//If an input and output are provided program runs in mkv mode
+	//Add -pipelined in mkv mode to keep several captures in the tracker at once
+	//Add -segments N (-warmup ms) in mkv mode to track N time segments in parallel with one tracker each
+	//Tracked skeletons are cached per recording in -cachedir (default skeletonCache), add -nocache to always track
 	//If only an output is provided program runs in realtime mode
 	//If neither are provided program runs in image mode
+	//Add -stats file.json in any mode to save the per-stage timing table printed at exit
+	//Add -trace file.json in any mode to save a Chrome trace of pipeline events for chrome://tracing or Perfetto
+	//Add -rigged in any mode to export glTF joints as a skinned hierarchy with rotation channels instead of free moving points
+	//Add -quantize with -rigged in any mode to store glTF rotation channels as normalised int16, translations stay float, the exporter reports the error
+	//Add -spline mm (-splineangle degrees) in any mode to fit glTF animation channels with cubic splines within that error, the exporter reports the key count and error
+	//Add -meshopt in any mode to compress glTF animation buffer views with EXT_meshopt_compression, lossless and combinable with the options above
 
 //MKV Mode: Create skeletons from saved mkv file
 	//Step 1: Get mkv file
 	//Step 2: Convert mkv file to skeletons
 	//Step 3: Convert skeletons to fbx or gltf file
+	//A .glb output writes the glTF manifest and buffer as one binary file
+
+//Batch Mode: Convert every recording in a directory or glob (azureProgram.exe -batch (input dir or glob) (fbx, gltf or glb) (-workers N))
+	//Step 1: Find mkv files
+	//Step 2: Convert them on a pool of workers that share the FBX SDK, each file gets a fresh tracker so it matches -mkv
+	//Step 3: Report per-file and total throughput
 
 //Realtime Mode: Create skeletons from realtime recording
 	//Step 1: Initialize the kinect
@@ -27,8 +52,47 @@
 		//2A: Get frame from kinect
 		//2B: Create skeletons from frame
 		//2C: Save skeletons data
-	//Step 3: End recording (Press space bar to stop recording)
-	//Step 4: Create fbx or gltf from skeleton data
+	//Step 3: End recording (Press space bar to stop recording, or after one minute unless -unbounded is given)
+	//Use -overload latest|drop|block (-dropevery N) to choose how frames are shed when tracking falls behind
+	//Step 4: Finish the fbx or gltf, which was written while recording
+	//Every frame is journaled to (output).journal.skel while recording, it is removed once the output is written
+
+//Replay Mode: Run the realtime pipeline on a recording paced by its timestamps (azureProgram.exe -replay (input.mkv) (output.___) (-options))
+	//Use -speed x to replay faster or slower than recorded, the realtime options -unbounded, -overload and -dropevery also apply
+	//Osc messages are sent as in realtime mode
+
+//Export Mode: Convert a recorded skeleton file without tracking again (azureProgram.exe -export (input.skel) (output.___) (-from s) (-to s))
+	//Any mode can write a .skel file by giving it a .skel output
+	//Use -from and -to to export only part of the recording, in seconds from the first frame
+	//A .skelz output or input is the compressed skeleton format, several times smaller than .skel, recording modes keep a .skelz session in memory until it is written
+	//Add -precision mm and -qbits B in any mode to set the .skelz position step and orientation bits, outputs that do not hold them are refused
+
+//Takes Mode: Write several recorded skeleton files as animations of one glTF (azureProgram.exe -takes (output.gltf) (input1.skel) (input2.skel) ...)
+	//Every take animates the same joint nodes from one buffer, .skel and .skelz inputs are named after their file
+	//FBX and glTF inputs add every animation they hold, so takes can be merged into an existing document
+	//The glTF export options apply, rigged documents are bound to the first frame of the first take
+
+//Import Mode: Convert an exported file back without tracking again (azureProgram.exe -import (input.gltf, .glb or .fbx) (output.___) (-take name))
+	//Joints are read back by name and resampled at 30 fps, rigged, quantised, spline and meshopt glTF exports are all read
+	//A glTF output keeps every take of the input, other outputs get the first one or the take named by -take
+	//Orientations only survive rigged glTF exports, files keep no confidence so every joint is read back as medium
+
+//Codec Benchmark Mode: Measure the compressed skeleton format (azureProgram.exe -benchcodec (input.skel) (-options))
+	//Without an input generated skeletons are used, -frames N sets how many
+	//Use -precision mm and -qbits B to set the position step and orientation component bits
+	//Reports encode and decode throughput, compression ratio and the largest round trip error
+
+//Recover Mode: Convert the journal of a recording that failed or crashed (azureProgram.exe -recover (output.journal.skel) (output.___))
+	//A frame cut off by the crash is dropped and the journal is closed, so it can also be used with -export afterwards
+
+//glTF Benchmark Mode: Measure glTF accessor construction (azureProgram.exe -benchgltf (output.gltf) (-options))
+	//Use -frames N to size the generated session (default 100000) and -workers N to limit the bounds threads
+	//Reports the joint bounds pass for the scalar baseline, SIMD and SIMD across joints, then the full export if an output is given
+	//Also checks the meshopt codec round trips float translations and float and quantised rotations exactly and reports its ratio and speed
+
+//Synthetic Mode: Run the realtime pipeline on generated skeletons without a Kinect (azureProgram.exe -synthetic (output.___) (-options))
+	//Use -frames N and -fps F to size the session, -unpaced to generate frames as fast as possible
+	//Add -nojournal to record without the skeleton journal, -stats reports the time each frame spends in it as "journal append"
 
 //Image Mode: Save color and transformed depth image
 	//Step 1: Capture color and depth image
@@ -40,22 +104,92 @@
 
 int main(int argc, char **argv) 
 {	
-	UdpTransmitSocket transmitSocket(IpEndpointName(ADDRESS, OUTPUT_PORT));
+	//OSC messages are only sent and received on Windows, see oscFunctions.h
+#ifdef _WIN32
+	UdpTransmitSocket oscSocket(IpEndpointName(ADDRESS, OUTPUT_PORT));
+	UdpTransmitSocket* transmitSocket = &oscSocket;
+#else
+	UdpTransmitSocket* transmitSocket = NULL;
+#endif
 	std::string errorMessage = "";
 	std::string mode = argv[1];
+
+	//Record a timeline of pipeline events when asked for
+	if (hasFlag(argc, argv, "-trace")) {
+		startTracing();
+		setTraceThreadName("main");
+	}
+
+	//Outputs of every mode share the export options
+	ExportOptions exportOptions;
+	exportOptions.gltf.rigged = hasFlag(argc, argv, "-rigged");
+	exportOptions.gltf.quantized = hasFlag(argc, argv, "-quantize");
+	exportOptions.gltf.meshopt = hasFlag(argc, argv, "-meshopt");
+	exportOptions.gltf.splineToleranceMm = getFlagDouble(argc, argv, "-spline", 0);
+	exportOptions.gltf.splineToleranceDegrees = getFlagDouble(argc, argv, "-splineangle", GLTF_SPLINE_DEFAULT_DEGREES);
+	exportOptions.skelz.positionPrecisionMm = (float)getFlagDouble(argc, argv, "-precision", SKELETON_CODEC_DEFAULT_PRECISION_MM);
+	exportOptions.skelz.orientationBits = getFlagValue(argc, argv, "-qbits", SKELETON_CODEC_DEFAULT_ORIENTATION_BITS);
 	
-	if (mode == "-mkv" && argc == 4) {
+	if (mode == "-mkv" && argc >= 4) {
 		//Run mkv mode
-		errorMessage = mkvModeFunction(argv[2], argv[3]);
+		errorMessage = mkvModeFunction(argv[2], argv[3], exportOptions, hasFlag(argc, argv, "-pipelined"),
+			getFlagValue(argc, argv, "-segments", 1), getFlagValue(argc, argv, "-warmup", SEGMENT_DEFAULT_WARMUP_MS),
+			!hasFlag(argc, argv, "-nocache"), getFlagString(argc, argv, "-cachedir", TRACKER_CACHE_DEFAULT_DIR).c_str());
+	}
+	else if (mode == "-batch" && argc >= 4) {
+		//Run batch mode
+		errorMessage = batchModeFunction(argv[2], argv[3], exportOptions, getFlagValue(argc, argv, "-workers", BATCH_DEFAULT_WORKERS));
 	}
-	else if (mode == "-realtime" && argc == 3) {
+	else if (mode == "-realtime" && argc >= 3) {
 		//Start thread for receiving end recording message
-		std::thread lt = std::thread(ListenerThread);
+		startOscListener();
 
 		//Run realtime mode
-		errorMessage = realtimeModeFunction(argv[2], &transmitSocket);
+		errorMessage = realtimeModeFunction(argv[2], exportOptions, transmitSocket, hasFlag(argc, argv, "-unbounded"),
+			parseOverloadPolicy(getFlagString(argc, argv, "-overload", "block")), getFlagValue(argc, argv, "-dropevery", 2));
+	}
+	else if (mode == "-replay" && argc >= 4) {
+		//Start thread for receiving end recording message
+		startOscListener();
 
-		lt.detach();
+		//Run replay mode
+		errorMessage = replayModeFunction(argv[2], argv[3], exportOptions, transmitSocket, getFlagDouble(argc, argv, "-speed", REPLAY_DEFAULT_SPEED),
+			hasFlag(argc, argv, "-unbounded"), parseOverloadPolicy(getFlagString(argc, argv, "-overload", "block")), getFlagValue(argc, argv, "-dropevery", 2));
+	}
+	else if (mode == "-export" && argc >= 4) {
+		//Run export mode
+		errorMessage = exportModeFunction(argv[2], argv[3], exportOptions, getFlagDouble(argc, argv, "-from", 0), getFlagDouble(argc, argv, "-to", -1));
+	}
+	else if (mode == "-takes" && argc >= 4) {
+		//Run takes mode, every argument after the output up to the first option is a take
+		std::vector<std::string> input_paths;
+		for (int i = 3; i < argc && argv[i][0] != '-'; i++) {
+			input_paths.push_back(argv[i]);
+		}
+		errorMessage = takesModeFunction(argv[2], input_paths, exportOptions.gltf);
+	}
+	else if (mode == "-import" && argc >= 4) {
+		//Run import mode
+		errorMessage = importModeFunction(argv[2], argv[3], exportOptions, getFlagString(argc, argv, "-take", ""));
+	}
+	else if (mode == "-recover" && argc >= 4) {
+		//Run recover mode
+		errorMessage = recoverModeFunction(argv[2], argv[3], exportOptions);
+	}
+	else if (mode == "-benchcodec") {
+		//Run codec benchmark mode
+		const char* input_path = argc >= 3 && argv[2][0] != '-' ? argv[2] : NULL;
+		errorMessage = codecBenchModeFunction(input_path, exportOptions.skelz, getFlagValue(argc, argv, "-frames", CODEC_BENCH_DEFAULT_FRAMES));
+	}
+	else if (mode == "-benchgltf") {
+		//Run glTF benchmark mode
+		const char* output_path = argc >= 3 && argv[2][0] != '-' ? argv[2] : NULL;
+		errorMessage = gltfBenchModeFunction(output_path, exportOptions.gltf, getFlagValue(argc, argv, "-frames", GLTF_BENCH_DEFAULT_FRAMES), getFlagValue(argc, argv, "-workers", 0));
+	}
+	else if (mode == "-synthetic" && argc >= 3) {
+		//Run synthetic mode
+		errorMessage = syntheticModeFunction(argv[2], exportOptions, getFlagValue(argc, argv, "-frames", REALTIME_MAX_FRAMES),
+			getFlagValue(argc, argv, "-fps", SYNTHETIC_DEFAULT_FPS), !hasFlag(argc, argv, "-unpaced"), !hasFlag(argc, argv, "-nojournal"));
 	}
 	else if (mode == "-image" && argc == 2) {
 		// Run image mode
@@ -72,8 +206,19 @@ int main(int argc, char **argv)
 		errorMessage = "Invalid number of arguments. Use \"azureProgram.exe -mode (input.mkv) (output.fbx)\".";
 	}
 
+	//Report time spent in each pipeline stage
+	printProfileReport();
+	if (hasFlag(argc, argv, "-stats") && !writeProfileJson(getFlagString(argc, argv, "-stats", "stats.json"))) {
+		std::cout << "Failed to write stage statistics." << std::endl;
+	}
+
 	//Send end of program osc message
-	sendEndOfProgramMessage(errorMessage, &transmitSocket);
+	sendEndOfProgramMessage(errorMessage, transmitSocket);
+
+	//Save the timeline
+	if (hasFlag(argc, argv, "-trace") && !writeTrace(getFlagString(argc, argv, "-trace", "trace.json"))) {
+		std::cout << "Failed to write trace." << std::endl;
+	}
 
 	//End program
 	if (errorMessage == "") {
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+//Attribute codec of EXT_meshopt_compression, bitstream version 0. Elements are split into blocks, every byte
+//position of a block is delta coded against the element before it, zigzagged, and packed in groups of 16 bytes
+//at 0, 2, 4 or 8 bits with the values that do not fit stored whole after the group.
+#define MESHOPT_ATTRIBUTE_HEADER 0xa0
+#define MESHOPT_BYTE_GROUP_SIZE 16
+#define MESHOPT_BLOCK_BYTES 8192
+#define MESHOPT_BLOCK_MAX_ELEMENTS 256
+#define MESHOPT_TAIL_MIN_SIZE 32
+
+//Elements per block, a multiple of the group size that keeps one block within 8 KB
+size_t meshoptBlockElements(size_t stride) {
+	size_t elements = (MESHOPT_BLOCK_BYTES / stride) & ~(size_t)(MESHOPT_BYTE_GROUP_SIZE - 1);
+	return std::min(elements, (size_t)MESHOPT_BLOCK_MAX_ELEMENTS);
+}
+
+uint8_t zigzag8(uint8_t value) {
+	return (uint8_t)((value << 1) ^ ((value & 0x80) ? 0xff : 0));
+}
+
+uint8_t unzigzag8(uint8_t value) {
+	return (uint8_t)(-(value & 1) ^ (value >> 1));
+}
+
+//Encoded size of a group at bits per value, values at or above the all-ones sentinel cost a whole extra byte
+size_t meshoptGroupSize(const uint8_t* group, int bits) {
+	if (bits == 0) {
+		for (int i = 0; i < MESHOPT_BYTE_GROUP_SIZE; i++) {
+			if (group[i] != 0) {
+				return SIZE_MAX;
+			}
+		}
+		return 0;
+	}
+	if (bits == 8) {
+		return MESHOPT_BYTE_GROUP_SIZE;
+	}
+	size_t size = MESHOPT_BYTE_GROUP_SIZE * bits / 8;
+	uint8_t sentinel = (uint8_t)((1 << bits) - 1);
+	for (int i = 0; i < MESHOPT_BYTE_GROUP_SIZE; i++) {
+		size += group[i] >= sentinel;
+	}
+	return size;
+}
+
+//Packs size bytes, a multiple of the group size, behind a header of two bits per group
+void meshoptEncodeBytes(const uint8_t* values, size_t size, std::vector<uint8_t>* out) {
+	size_t headerOffset = out->size();
+	out->resize(out->size() + (size / MESHOPT_BYTE_GROUP_SIZE + 3) / 4, 0);
+	for (size_t i = 0; i < size; i += MESHOPT_BYTE_GROUP_SIZE) {
+		const uint8_t* group = values + i;
+		int bitsLog2 = 3;
+		size_t bestSize = MESHOPT_BYTE_GROUP_SIZE;
+		for (int candidate = 0; candidate < 3; candidate++) {
+			size_t candidateSize = meshoptGroupSize(group, candidate == 0 ? 0 : 1 << candidate);
+			if (candidateSize < bestSize) {
+				bitsLog2 = candidate;
+				bestSize = candidateSize;
+			}
+		}
+		size_t groupIndex = i / MESHOPT_BYTE_GROUP_SIZE;
+		(*out)[headerOffset + groupIndex / 4] |= (uint8_t)(bitsLog2 << ((groupIndex % 4) * 2));
+
+		if (bitsLog2 == 3) {
+			out->insert(out->end(), group, group + MESHOPT_BYTE_GROUP_SIZE);
+		}
+		else if (bitsLog2 > 0) {
+			//Fixed part first, earlier values in the higher bits, then the values that hit the sentinel
+			int bits = 1 << bitsLog2;
+			uint8_t sentinel = (uint8_t)((1 << bits) - 1);
+			for (int k = 0; k < MESHOPT_BYTE_GROUP_SIZE; k += 8 / bits) {
+				uint8_t packed = 0;
+				for (int j = 0; j < 8 / bits; j++) {
+					packed = (uint8_t)((packed << bits) | std::min(group[k + j], sentinel));
+				}
+				out->push_back(packed);
+			}
+			for (int k = 0; k < MESHOPT_BYTE_GROUP_SIZE; k++) {
+				if (group[k] >= sentinel) {
+					out->push_back(group[k]);
+				}
+			}
+		}
+	}
+}
+
+//Encodes count elements of stride bytes, stride a multiple of 4 up to 256 as the extension requires. The first
+//element is the baseline of the first block's deltas and is repeated at the end of the stream, padded to 32 bytes.
+void meshoptEncodeAttributes(const uint8_t* data, size_t count, size_t stride, std::vector<uint8_t>* out) {
+	out->clear();
+	out->push_back(MESHOPT_ATTRIBUTE_HEADER);
+
+	uint8_t first[256] = { 0 };
+	if (count > 0) {
+		std::memcpy(first, data, stride);
+	}
+	uint8_t last[256];
+	std::memcpy(last, first, stride);
+
+	uint8_t deltas[MESHOPT_BLOCK_MAX_ELEMENTS];
+	size_t blockElements = meshoptBlockElements(stride);
+	for (size_t offset = 0; offset < count; offset += blockElements) {
+		size_t elements = std::min(blockElements, count - offset);
+		size_t alignedElements = (elements + MESHOPT_BYTE_GROUP_SIZE - 1) & ~(size_t)(MESHOPT_BYTE_GROUP_SIZE - 1);
+		const uint8_t* block = data + offset * stride;
+		for (size_t k = 0; k < stride; k++) {
+			uint8_t previous = last[k];
+			for (size_t i = 0; i < elements; i++) {
+				deltas[i] = zigzag8((uint8_t)(block[i * stride + k] - previous));
+				previous = block[i * stride + k];
+			}
+			std::fill(deltas + elements, deltas + alignedElements, 0);
+			meshoptEncodeBytes(deltas, alignedElements, out);
+		}
+		std::memcpy(last, block + (elements - 1) * stride, stride);
+	}
+
+	if (stride < MESHOPT_TAIL_MIN_SIZE) {
+		out->resize(out->size() + MESHOPT_TAIL_MIN_SIZE - stride, 0);
+	}
+	out->insert(out->end(), first, first + stride);
+}
+
+//Decodes count elements of stride bytes into out, returns an error message, empty on success
+std::string meshoptDecodeAttributes(const uint8_t* encoded, size_t size, size_t count, size_t stride, uint8_t* out) {
+	size_t tailSize = std::max(stride, (size_t)MESHOPT_TAIL_MIN_SIZE);
+	if (stride == 0 || stride > 256 || stride % 4 != 0) {
+		return "Invalid meshopt element stride.\n";
+	}
+	if (size < 1 + tailSize || encoded[0] != MESHOPT_ATTRIBUTE_HEADER) {
+		return "Invalid meshopt attribute stream.\n";
+	}
+	const uint8_t* data = encoded + 1;
+	const uint8_t* end = encoded + size - tailSize;
+	uint8_t last[256];
+	std::memcpy(last, encoded + size - stride, stride);
+
+	uint8_t deltas[MESHOPT_BLOCK_MAX_ELEMENTS];
+	size_t blockElements = meshoptBlockElements(stride);
+	for (size_t offset = 0; offset < count; offset += blockElements) {
+		size_t elements = std::min(blockElements, count - offset);
+		size_t alignedElements = (elements + MESHOPT_BYTE_GROUP_SIZE - 1) & ~(size_t)(MESHOPT_BYTE_GROUP_SIZE - 1);
+		size_t groups = alignedElements / MESHOPT_BYTE_GROUP_SIZE;
+		uint8_t* block = out + offset * stride;
+		for (size_t k = 0; k < stride; k++) {
+			const uint8_t* header = data;
+			data += (groups + 3) / 4;
+			if (data > end) {
+				return "Truncated meshopt attribute stream.\n";
+			}
+			for (size_t g = 0; g < groups; g++) {
+				int bitsLog2 = (header[g / 4] >> ((g % 4) * 2)) & 3;
+				uint8_t* group = deltas + g * MESHOPT_BYTE_GROUP_SIZE;
+				if (bitsLog2 == 0) {
+					std::memset(group, 0, MESHOPT_BYTE_GROUP_SIZE);
+					continue;
+				}
+				int bits = 1 << bitsLog2;
+				size_t fixedSize = MESHOPT_BYTE_GROUP_SIZE * bits / 8;
+				if ((size_t)(end - data) < fixedSize) {
+					return "Truncated meshopt attribute stream.\n";
+				}
+				if (bits == 8) {
+					std::memcpy(group, data, MESHOPT_BYTE_GROUP_SIZE);
+					data += MESHOPT_BYTE_GROUP_SIZE;
+					continue;
+				}
+				const uint8_t* extra = data + fixedSize;
+				uint8_t sentinel = (uint8_t)((1 << bits) - 1);
+				for (int i = 0; i < MESHOPT_BYTE_GROUP_SIZE; i++) {
+					uint8_t value = (uint8_t)((data[i * bits / 8] >> (8 - bits - (i * bits) % 8)) & sentinel);
+					if (value == sentinel) {
+						if (extra >= end) {
+							return "Truncated meshopt attribute stream.\n";
+						}
+						value = *extra++;
+					}
+					group[i] = value;
+				}
+				data = extra;
+			}
+
+			uint8_t previous = last[k];
+			for (size_t i = 0; i < elements; i++) {
+				previous = (uint8_t)(unzigzag8(deltas[i]) + previous);
+				block[i * stride + k] = previous;
+			}
+		}
+		std::memcpy(last, block + (elements - 1) * stride, stride);
+	}
+	if (data != end) {
+		return "Unexpected data after the meshopt attribute stream.\n";
+	}
+	return "";
+}
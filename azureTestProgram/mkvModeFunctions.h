@@ -5,116 +5,400 @@
 #include <k4arecord/playback.h>
 #include <k4abt.h>
 
-#include "fbxFunctions.h"
-#include "gltfFunctions.h"
+#include "exportFunctions.h"
 #include "checkerFunctions.h"
-#include "windows.h"
-#include "fileapi.h"
+#include "captureSourceFunctions.h"
+#include "profilerFunctions.h"
+#include "skeletonTrackFunctions.h"
+#include "trackerCacheFunctions.h"
 
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
-std::string mkvModeFunction(const char* input_path, const char* output_path) {
-	std::vector<k4abt_skeleton_t> skeletons;
+#define PIPELINE_POP_TIMEOUT_MS 100
+#define SEGMENT_DEFAULT_WARMUP_MS 2000
+
+//Keeps up to PIPELINE_MAX_IN_FLIGHT captures queued in the tracker while a consumer thread pops results,
+//so playback decode, tracker inference and result handling overlap instead of running one after another
+std::string trackRecordingPipelined(k4a_playback_t playback_handle, k4abt_tracker_t tracker, SkeletonTrack* track, size_t* trackedFrames) {
 	std::string errorMessage = "";
+	std::string consumerErrorMessage = "";
+	std::mutex slotMutex;
+	std::condition_variable slotCondition;
+	int inFlight = 0;
+	std::deque<uint64_t> enqueueTimes;
+	std::atomic<bool> producerDone(false);
+	std::atomic<bool> consumerFailed(false);
 
-	//Check output file existence
-	if (fileExists(output_path)) {
-		errorMessage += "Output file already exists, please choose another name.\n";
+	//Consumer: pop body frames as they finish and save the first skeleton of each
+	std::thread consumer([&]() {
+		setTraceThreadName("tracker consumer");
+		while (!consumerFailed) {
+			{
+				std::lock_guard<std::mutex> lock(slotMutex);
+				if (producerDone && inFlight == 0) {
+					break;
+				}
+			}
+
+			k4abt_frame_t body_frame = NULL;
+			uint64_t popStart = profileNowNsec();
+			k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(tracker, &body_frame, PIPELINE_POP_TIMEOUT_MS);
+			if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED) {
+				uint64_t popEnd = profileNowNsec();
+				recordProfileStage(STAGE_TRACKER_POP, popStart, popEnd);
+				uint32_t num_bodies = k4abt_frame_get_num_bodies(body_frame);
+				if (num_bodies > 0) {
+					k4abt_skeleton_t skeleton;
+					k4abt_frame_get_body_skeleton(body_frame, 0, &skeleton);
+					track->append(skeleton, k4abt_frame_get_device_timestamp_usec(body_frame));
+				}
+				k4abt_frame_release(body_frame);
+				(*trackedFrames)++;
+
+				std::lock_guard<std::mutex> lock(slotMutex);
+				if (!enqueueTimes.empty()) {
+					recordProfileStage(STAGE_TRACKER_LATENCY, enqueueTimes.front(), popEnd);
+					enqueueTimes.pop_front();
+				}
+				inFlight--;
+				slotCondition.notify_one();
+			}
+			else if (pop_frame_result == K4A_WAIT_RESULT_FAILED) {
+				consumerErrorMessage += "Pop body frame result failed.\n";
+				std::lock_guard<std::mutex> lock(slotMutex);
+				consumerFailed = true;
+				slotCondition.notify_one();
+			}
+		}
+	});
+
+	//Producer: decode captures and enqueue them as soon as a tracker slot is free
+	bool running = true;
+	while (running && errorMessage == "" && !consumerFailed) {
+		k4a_capture_t capture_handle = nullptr;
+		uint64_t captureStart = profileNowNsec();
+		k4a_stream_result_t stream_result = k4a_playback_get_next_capture(playback_handle, &capture_handle);
+
+		if (stream_result == K4A_STREAM_RESULT_SUCCEEDED) {
+			recordProfileStage(STAGE_CAPTURE, captureStart, profileNowNsec());
+			if (check_depth_image_exists(capture_handle)) {
+				uint64_t enqueueStart;
+				{
+					std::unique_lock<std::mutex> lock(slotMutex);
+					slotCondition.wait(lock, [&]() { return inFlight < PIPELINE_MAX_IN_FLIGHT || consumerFailed; });
+					inFlight++;
+					enqueueStart = profileNowNsec();
+					enqueueTimes.push_back(enqueueStart);
+				}
+
+				k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(tracker, capture_handle, K4A_WAIT_INFINITE);
+				if (queue_capture_result != K4A_WAIT_RESULT_SUCCEEDED) {
+					errorMessage += ("Add capture to tracker process queue failed.\n");
+					std::lock_guard<std::mutex> lock(slotMutex);
+					enqueueTimes.pop_back();
+					inFlight--;
+				}
+				else {
+					recordProfileStage(STAGE_TRACKER_ENQUEUE, enqueueStart, profileNowNsec());
+				}
+			}
+			k4a_capture_release(capture_handle);
+		}
+		else if (stream_result == K4A_STREAM_RESULT_EOF) {
+			running = false;
+		}
+		else {
+			errorMessage += "Failed to read current frame.\n";
+		}
+	}
+
+	//Let the consumer drain whatever is still in the tracker
+	{
+		std::lock_guard<std::mutex> lock(slotMutex);
+		producerDone = true;
+	}
+	if (errorMessage != "") {
+		consumerFailed = true;
 	}
+	consumer.join();
+
+	return errorMessage + consumerErrorMessage;
+}
+
+//Tracks one time segment of a recording with its own playback handle and tracker. Tracking starts
+//warmupUsec before the segment so the tracker has stabilised by segmentStartUsec; warm-up results are dropped.
+//Segment bounds are relative to the start of the recording. trackedFrames counts the segment's own frames and
+//warmupFrames the dropped ones, which were tracked all the same.
+std::string trackRecordingSegment(const char* input_path, uint64_t segmentStartUsec, uint64_t segmentEndUsec, uint64_t warmupUsec, SkeletonTrack* segmentTrack,
+	size_t* trackedFrames, size_t* warmupFrames) {
+	std::string errorMessage = "";
 
-	//Find the mkv file and check that it exists
 	k4a_playback_t playback_handle = nullptr;
-	k4a_result_t result = k4a_playback_open(input_path, &playback_handle);
-	if (K4A_RESULT_SUCCEEDED != result)	{
-		errorMessage += "Cannot open recording.\n";
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_open(input_path, &playback_handle)) {
+		return "Cannot open recording.\n";
 	}
 
-	//Calibrate the mkv file to be played back
 	k4a_calibration_t calibration;
-	result = k4a_playback_get_calibration(playback_handle, &calibration);
-	if (errorMessage == "" && K4A_RESULT_SUCCEEDED != result)	{
+	k4a_record_configuration_t record_config;
+	if (K4A_RESULT_SUCCEEDED != k4a_playback_get_calibration(playback_handle, &calibration)) {
 		errorMessage += "Failed to get calibration.\n";
 	}
+	if (errorMessage == "" && K4A_RESULT_SUCCEEDED != k4a_playback_get_record_configuration(playback_handle, &record_config)) {
+		errorMessage += "Failed to get recording configuration.\n";
+	}
 
-	//Create body tracker
 	k4abt_tracker_t tracker = NULL;
 	k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
 	if (errorMessage == "" && K4A_RESULT_SUCCEEDED != k4abt_tracker_create(&calibration, tracker_config, &tracker)) {
 		errorMessage += "Body tracker initialization failed.\n";
 	}
 
-	//Process mkv recording data
+	//Seek to the start of the warm-up window
+	uint64_t seekUsec = segmentStartUsec > warmupUsec ? segmentStartUsec - warmupUsec : 0;
+	if (errorMessage == "" && K4A_RESULT_SUCCEEDED != k4a_playback_seek_timestamp(playback_handle, (int64_t)seekUsec, K4A_PLAYBACK_SEEK_BEGIN)) {
+		errorMessage += "Failed to seek recording.\n";
+	}
+
 	bool running = true;
 	while (running && errorMessage == "") {
-		//Get current frame
 		k4a_capture_t capture_handle = nullptr;
+		uint64_t captureStart = profileNowNsec();
 		k4a_stream_result_t stream_result = k4a_playback_get_next_capture(playback_handle, &capture_handle);
 
-		//Process current frame
 		if (stream_result == K4A_STREAM_RESULT_SUCCEEDED) {
-			if (check_depth_image_exists(capture_handle)) {
-				k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(tracker, capture_handle, K4A_WAIT_INFINITE);
-				k4a_capture_release(capture_handle);
-				if (queue_capture_result == K4A_WAIT_RESULT_FAILED) {
-					errorMessage += ("Add capture to tracker process queue failed.\n");
-				}
+			recordProfileStage(STAGE_CAPTURE, captureStart, profileNowNsec());
+			k4a_image_t depth = k4a_capture_get_depth_image(capture_handle);
+			if (depth != nullptr) {
+				uint64_t captureUsec = k4a_image_get_device_timestamp_usec(depth) - record_config.start_timestamp_offset_usec;
+				k4a_image_release(depth);
 
-				//Get skeleton from current frame
-				k4abt_frame_t body_frame = NULL;
-				k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(tracker, &body_frame, K4A_WAIT_INFINITE);
-				if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED && errorMessage == "") {
-					uint32_t num_bodies = k4abt_frame_get_num_bodies(body_frame);
-					if (num_bodies > 0) {
-						k4abt_skeleton_t skeleton;
-						k4abt_frame_get_body_skeleton(body_frame, 0, &skeleton);
-						skeletons.push_back(skeleton);
-					}
-					k4abt_frame_release(body_frame);
+				//Stop once this segment's time range is covered
+				if (captureUsec >= segmentEndUsec) {
+					running = false;
 				}
 				else {
-					errorMessage += "Pop body frame result failed.\n";
+					uint64_t enqueueStart = profileNowNsec();
+					k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(tracker, capture_handle, K4A_WAIT_INFINITE);
+					if (queue_capture_result == K4A_WAIT_RESULT_FAILED) {
+						errorMessage += ("Add capture to tracker process queue failed.\n");
+					}
+
+					k4abt_frame_t body_frame = NULL;
+					uint64_t popStart = profileNowNsec();
+					k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(tracker, &body_frame, K4A_WAIT_INFINITE);
+					if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED && errorMessage == "") {
+						uint64_t popEnd = profileNowNsec();
+						recordProfileStage(STAGE_TRACKER_ENQUEUE, enqueueStart, popStart);
+						recordProfileStage(STAGE_TRACKER_POP, popStart, popEnd);
+						recordProfileStage(STAGE_TRACKER_LATENCY, enqueueStart, popEnd);
+						uint64_t deviceUsec = k4abt_frame_get_device_timestamp_usec(body_frame);
+						uint64_t frameUsec = deviceUsec - record_config.start_timestamp_offset_usec;
+						if (frameUsec < segmentStartUsec) {
+							(*warmupFrames)++;
+						}
+						else {
+							if (k4abt_frame_get_num_bodies(body_frame) > 0) {
+								k4abt_skeleton_t skeleton;
+								k4abt_frame_get_body_skeleton(body_frame, 0, &skeleton);
+								segmentTrack->append(skeleton, deviceUsec);
+							}
+							(*trackedFrames)++;
+						}
+						k4abt_frame_release(body_frame);
+					}
+					else {
+						errorMessage += "Pop body frame result failed.\n";
+					}
 				}
 			}
+			k4a_capture_release(capture_handle);
 		}
 		else if (stream_result == K4A_STREAM_RESULT_EOF) {
 			running = false;
 		}
 		else {
 			errorMessage += "Failed to read current frame.\n";
-		}	
+		}
 	}
 
-	//Release tracker and recording
-	k4abt_tracker_shutdown(tracker);
-	k4abt_tracker_destroy(tracker);
+	if (tracker != NULL) {
+		k4abt_tracker_shutdown(tracker);
+		k4abt_tracker_destroy(tracker);
+	}
 	k4a_playback_close(playback_handle);
 
-	//Create output path
-	std::experimental::filesystem::path path = output_path;
-	CreateDirectory(path.parent_path().string().c_str(), NULL);
+	return errorMessage;
+}
 
-	//Create FBX or GLTF from skeletons vector
-	bool success = true;
-	if (errorMessage == "") {
-		if (outputFBX(output_path)) {
-			success = createFBX(skeletons, output_path);
+//Splits the recording into segmentCount time ranges, tracks each on its own thread and stitches the
+//segment tracks back together in time order
+std::string trackRecordingSegmented(const char* input_path, uint64_t recordingLengthUsec, int segmentCount, uint64_t warmupUsec, SkeletonTrack* track,
+	size_t* trackedFrames, size_t* warmupFrames) {
+	std::vector<SkeletonTrack> segmentTracks(segmentCount);
+	std::vector<std::string> segmentErrors(segmentCount);
+	std::vector<size_t> segmentFrames(segmentCount, 0);
+	std::vector<size_t> segmentWarmupFrames(segmentCount, 0);
+	std::vector<std::thread> segmentThreads;
+
+	uint64_t segmentLengthUsec = recordingLengthUsec / segmentCount + 1;
+	for (int i = 0; i < segmentCount; i++) {
+		uint64_t segmentStartUsec = i * segmentLengthUsec;
+		uint64_t segmentEndUsec = (i == segmentCount - 1) ? UINT64_MAX : segmentStartUsec + segmentLengthUsec;
+		segmentThreads.push_back(std::thread([&, i, segmentStartUsec, segmentEndUsec]() {
+			setTraceThreadName("segment " + std::to_string(i));
+			segmentErrors[i] = trackRecordingSegment(input_path, segmentStartUsec, segmentEndUsec, warmupUsec, &segmentTracks[i], &segmentFrames[i], &segmentWarmupFrames[i]);
+		}));
+	}
+
+	std::string errorMessage = "";
+	for (int i = 0; i < segmentCount; i++) {
+		segmentThreads[i].join();
+		if (segmentErrors[i] != "") {
+			errorMessage += "Segment " + std::to_string(i) + ": " + segmentErrors[i];
 		}
-		else if (outputGLTF(output_path)) {
-			success = createGLTF(skeletons, output_path);
+		*trackedFrames += segmentFrames[i];
+		*warmupFrames += segmentWarmupFrames[i];
+	}
+
+	//Segments cover consecutive disjoint time ranges and warm-up frames were dropped, so joining them in order keeps time order
+	size_t stitchedFrames = track->size();
+	for (int i = 0; i < segmentCount; i++) {
+		stitchedFrames += segmentTracks[i].size();
+	}
+	track->reserve(stitchedFrames);
+	for (int i = 0; i < segmentCount; i++) {
+		track->append(segmentTracks[i]);
+	}
+
+	return errorMessage;
+}
+
+std::string mkvModeFunction(const char* input_path, const char* output_path, const ExportOptions& options, bool pipelined = false, int segmentCount = 1, int warmupMs = SEGMENT_DEFAULT_WARMUP_MS,
+	bool useCache = true, const char* cacheDirectory = TRACKER_CACHE_DEFAULT_DIR) {
+	SkeletonTrack track;
+	std::string errorMessage = "";
+
+	//Check output file existence
+	if (fileExists(output_path)) {
+		errorMessage += "Output file already exists, please choose another name.\n";
+	}
+
+	//Look for skeletons tracked from the same recording with the same settings. Pipelined and sequential tracking
+	//produce the same skeletons, segmented tracking differs around segment starts so it is cached separately.
+	k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
+	std::string trackingMode = segmentCount > 1 ? "segments " + std::to_string(segmentCount) + " warmup " + std::to_string(warmupMs) : "sequential";
+	TrackerCache cache(cacheDirectory);
+	bool cacheHit = false;
+	k4a_calibration_t calibration;
+	bool haveCalibration = false;
+	if (errorMessage == "" && useCache && cache.prepare(input_path, tracker_config, trackingMode)) {
+		auto loadStart = std::chrono::steady_clock::now();
+		cacheHit = cache.load(&track, &calibration, &haveCalibration);
+		std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+		if (cacheHit) {
+			std::cout << "Loaded " << track.size() << " frames from tracker cache " << cache.entryPath() << " in " << loadTime.count() << " s" << std::endl;
 		}
-		else {
-			errorMessage += "Invalid output type. Use either -f or -g.\n";
+	}
+
+	//Process mkv recording data
+	size_t trackedFrames = 0;
+	size_t warmupFrames = 0;
+	auto trackingStart = std::chrono::steady_clock::now();
+	if (errorMessage == "" && cacheHit) {
+		//Skip straight to the export
+	}
+	else if (errorMessage == "" && segmentCount > 1) {
+		//Segmented tracking opens a playback handle and tracker per segment, this one is only needed for the length
+		PlaybackCaptureSource playback(input_path);
+		errorMessage += playback.open();
+		if (errorMessage == "") {
+			calibration = playback.calibration();
+			haveCalibration = true;
+			uint64_t recordingLengthUsec = k4a_playback_get_recording_length_usec(playback.handle());
+			playback.close();
+			errorMessage += trackRecordingSegmented(input_path, recordingLengthUsec, segmentCount, (uint64_t)warmupMs * 1000, &track, &trackedFrames, &warmupFrames);
+		}
+	}
+	else if (errorMessage == "" && pipelined) {
+		PlaybackCaptureSource playback(input_path);
+		errorMessage += playback.open();
+
+		if (errorMessage == "") {
+			calibration = playback.calibration();
+			haveCalibration = true;
+		}
+
+		//Create body tracker
+		k4abt_tracker_t tracker = NULL;
+		if (errorMessage == "" && K4A_RESULT_SUCCEEDED != k4abt_tracker_create(&playback.calibration(), tracker_config, &tracker)) {
+			tracker = NULL;
+			errorMessage += "Body tracker initialization failed.\n";
+		}
+		if (errorMessage == "") {
+			errorMessage += trackRecordingPipelined(playback.handle(), tracker, &track, &trackedFrames);
+		}
+
+		//Release tracker, the recording is closed with the source
+		if (tracker != NULL) {
+			k4abt_tracker_shutdown(tracker);
+			k4abt_tracker_destroy(tracker);
 		}
 	}
-	if (!success) {
-		if (outputFBX(output_path)) {
-			errorMessage += "An error occurred while creating the fbx.\n";
+	else if (errorMessage == "") {
+		//Track through the shared capture source pipeline, blocking so no frames are dropped
+		PlaybackCaptureSource playback(input_path);
+		TrackedSkeletonSource source(&playback, OVERLOAD_BLOCK);
+		errorMessage += source.open();
+		if (errorMessage == "") {
+			calibration = playback.calibration();
+			haveCalibration = true;
+			errorMessage += collectSkeletons(&source, nullptr, [&](const k4abt_skeleton_t& skeleton, uint64_t timestampUsec) {
+				track.append(skeleton, timestampUsec);
+			}, NULL);
 		}
-		else if (outputGLTF(output_path)) {
-			errorMessage += "An error occurred while creating the gltf.\n";
+		std::string closeMessage = source.close();
+		if (errorMessage == "") {
+			errorMessage += closeMessage;
 		}
+		trackedFrames = source.trackedFrames();
+	}
+
+	//Report tracking throughput over the recording's frames, segment warm-up is extra work and reported on its own
+	std::chrono::duration<double> trackingTime = std::chrono::steady_clock::now() - trackingStart;
+	if (errorMessage == "" && !cacheHit && trackingTime.count() > 0) {
+		std::cout << "Tracked " << trackedFrames << " frames in " << trackingTime.count() << " s ("
+			<< trackedFrames / trackingTime.count() << " frames/sec";
+		if (segmentCount > 1) {
+			std::cout << ", " << segmentCount << " segments, " << warmupFrames << " warm-up frames tracked and dropped";
+		}
+		else if (pipelined) {
+			std::cout << ", pipelined";
+		}
+		std::cout << ")" << std::endl;
+	}
+
+	//Keep the tracked skeletons for the next export of this recording, a failed cache write is not fatal
+	if (errorMessage == "" && useCache && !cacheHit && cache.entryPath() != "") {
+		if (cache.store(track, haveCalibration ? &calibration : NULL)) {
+			std::cout << "Saved tracker output to cache " << cache.entryPath() << std::endl;
+		}
+		else {
+			std::cout << "Could not write tracker cache entry " << cache.entryPath() << std::endl;
+		}
+	}
+
+	//Create FBX or GLTF from skeleton track
+	if (errorMessage == "") {
+		errorMessage += exportSkeletons(track, output_path, options, haveCalibration ? &calibration : NULL);
 	}
 
 	return errorMessage;
-}
\ No newline at end of file
+}
@@ -4,6 +4,8 @@
 #include <mutex>
 #include <string>
 
+#include "traceFunctions.h"
+
 #define ADDRESS "127.0.0.1"
 #define OUTPUT_PORT 7000
 #define INPUT_PORT 7001
@@ -20,6 +22,7 @@ protected:
 	{
 		(void)remoteEndpoint; // suppress unused parameter warning		
 		if (std::strcmp(m.AddressPattern(), "/End Recording/") == 0) {
+			traceInstant("osc end recording received");
 			oscMutex.lock();
 			endRecording = true;
 			oscMutex.unlock();
@@ -27,31 +30,54 @@ protected:
 	}
 };
 
+//oscpack's sockets are only built on Windows. Elsewhere there is no listener and no transmit socket, so modes run
+//without OSC messages and recordings are stopped by their length or the source ending.
+#ifdef _WIN32
 static void ListenerThread() {
+	setTraceThreadName("osc listener");
 	CustomPacketListener listener;
 	UdpListeningReceiveSocket s(
 		IpEndpointName(IpEndpointName::ANY_ADDRESS, INPUT_PORT),
 		&listener);
 	s.Run();
 }
+#endif
+
+//Listens for the end recording message in the background, does nothing without the OSC transport
+void startOscListener() {
+#ifdef _WIN32
+	std::thread(ListenerThread).detach();
+#endif
+}
+
+//Sends a finished packet, transmitSocket may be NULL when there is no OSC transport
+void sendOscPacket(UdpTransmitSocket* transmitSocket, const osc::OutboundPacketStream& p) {
+#ifdef _WIN32
+	if (transmitSocket != NULL) {
+		transmitSocket->Send(p.Data(), p.Size());
+	}
+#endif
+}
 
 void sendEndOfProgramMessage(std::string errorMessage, UdpTransmitSocket* transmitSocket) {
 	char buffer[OUTPUT_BUFFER_SIZE];
 	osc::OutboundPacketStream p(buffer, OUTPUT_BUFFER_SIZE);
 
+	TraceScope sendTrace("osc program complete");
 	if (errorMessage == "") {
 		p << osc::BeginBundleImmediate << osc::BeginMessage("/Program Complete/") << 1 << " " << osc::EndMessage << osc::EndBundle;		
 	}
 	else {
 		p << osc::BeginBundleImmediate << osc::BeginMessage("/Program Complete/") << 0 << errorMessage.c_str() << osc::EndMessage << osc::EndBundle;
 	}
-	transmitSocket->Send(p.Data(), p.Size());
+	sendOscPacket(transmitSocket, p);
 }
 
 void sendRecordingStartedMessage(UdpTransmitSocket* transmitSocket) {
 	char buffer[OUTPUT_BUFFER_SIZE];
 	osc::OutboundPacketStream p(buffer, OUTPUT_BUFFER_SIZE);
 
+	TraceScope sendTrace("osc recording started");
 	p << osc::BeginBundleImmediate << osc::BeginMessage("/Recording Started/") << osc::EndMessage << osc::EndBundle;
-	transmitSocket->Send(p.Data(), p.Size());
+	sendOscPacket(transmitSocket, p);
 }
\ No newline at end of file
@@ -40,6 +40,11 @@
 
 #include "NetworkingUtils.h"
 
+// sprintf_s is only provided by the Microsoft runtime, snprintf takes the same arguments
+#ifndef _WIN32
+#define sprintf_s snprintf
+#endif
+
 
 unsigned long IpEndpointName::GetHostByName( const char *s )
 {
@@ -36,6 +36,8 @@
 */
 #include "NetworkingUtils.h"
 
+#ifdef _WIN32
+
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 
 //#include <io.h>
@@ -96,3 +98,31 @@ unsigned long GetHostByName( const char *name )
 
 	return result;
 }
+
+#else
+
+// Name lookup for the other platforms, which need no networking setup.
+#include <netdb.h>
+#include <arpa/inet.h>
+
+#include <cstring>
+
+NetworkInitializer::NetworkInitializer() {}
+
+NetworkInitializer::~NetworkInitializer() {}
+
+unsigned long GetHostByName( const char *name )
+{
+	unsigned long result = 0;
+
+	struct hostent *h = gethostbyname(name);
+	if (h) {
+		struct in_addr a;
+		std::memcpy(&a, h->h_addr_list[0], h->h_length);
+		result = ntohl(a.s_addr);
+	}
+
+	return result;
+}
+
+#endif /* _WIN32 */
@@ -34,7 +34,9 @@
 	requested that these non-binding requests be included whenever the
 	above license is reproduced.
 */
+#ifdef _WIN32
 #pragma comment(lib, "Ws2_32.lib")
+#endif
 
 #ifndef INCLUDED_OSCPACK_NETWORKINGUTILS_H
 #define INCLUDED_OSCPACK_NETWORKINGUTILS_H
@@ -35,6 +35,10 @@
 	above license is reproduced.
 */
 
+// This is the win32 implementation. Other platforms build the program without
+// the OSC transport, see oscFunctions.h.
+#ifdef _WIN32
+
 #include <winsock2.h>   // this must come first to prevent errors with MSVC7
 #include <windows.h>
 #include <mmsystem.h>   // for timeGetTime()
@@ -569,3 +573,4 @@ void SocketReceiveMultiplexer::AsynchronousBreak()
 	impl_->AsynchronousBreak();
 }
 
+#endif /* _WIN32 */
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+
+#include "traceFunctions.h"
+
+#define PROFILE_SUB_BUCKET_BITS 3
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BUCKET_BITS)
+#define PROFILE_BUCKET_COUNT ((64 - PROFILE_SUB_BUCKET_BITS + 1) * PROFILE_SUB_BUCKETS)
+
+//Pipeline stages that are timed. Every capture loop records into the same stages so modes can be compared.
+enum ProfileStage {
+	STAGE_CAPTURE,			//Waiting on the device or decoding the next capture from a recording
+	STAGE_TRACKER_ENQUEUE,	//Handing a capture to the body tracker
+	STAGE_TRACKER_POP,		//Waiting for a finished body frame
+	STAGE_TRACKER_LATENCY,	//From enqueue to pop of the same frame
+	STAGE_EXPORT,			//Writing the FBX or glTF file
+	STAGE_IMPORT,			//Reading a skeleton, FBX or glTF file back into tracks
+	STAGE_JOURNAL,			//Appending a recorded frame to the skeleton journal on the capture thread
+	STAGE_COUNT
+};
+
+const char* profileStageNames[STAGE_COUNT] = { "capture", "tracker enqueue", "tracker pop", "tracker latency", "export", "import", "journal append" };
+
+uint64_t profileNowNsec() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Runs body repeatedly, at least three times and until minSeconds have passed, and returns seconds per pass. Used by
+//the benchmark modes so short operations are measured over many passes.
+template <typename Body>
+double timeBenchmarkPasses(Body body, double minSeconds = 1.0) {
+	int passes = 0;
+	std::chrono::duration<double> elapsed(0);
+	auto start = std::chrono::steady_clock::now();
+	while (passes < 3 || elapsed.count() < minSeconds) {
+		body();
+		passes++;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	return elapsed.count() / passes;
+}
+
+//Log-linear bucket index: exact below 8 ns, then 8 buckets per power of two, so any percentile is within 12.5%
+int profileBucket(uint64_t nsec) {
+	if (nsec < PROFILE_SUB_BUCKETS) {
+		return (int)nsec;
+	}
+	int exponent = 63;
+	while ((nsec >> exponent) == 0) {
+		exponent--;
+	}
+	int sub = (int)((nsec >> (exponent - PROFILE_SUB_BUCKET_BITS)) & (PROFILE_SUB_BUCKETS - 1));
+	return (exponent - PROFILE_SUB_BUCKET_BITS + 1) * PROFILE_SUB_BUCKETS + sub;
+}
+
+//Smallest value that lands in bucket
+uint64_t profileBucketLowerBound(int bucket) {
+	if (bucket < PROFILE_SUB_BUCKETS) {
+		return (uint64_t)bucket;
+	}
+	int exponent = bucket / PROFILE_SUB_BUCKETS + PROFILE_SUB_BUCKET_BITS - 1;
+	uint64_t sub = (uint64_t)(bucket % PROFILE_SUB_BUCKETS);
+	return (PROFILE_SUB_BUCKETS + sub) << (exponent - PROFILE_SUB_BUCKET_BITS);
+}
+
+//Latency histogram of one stage. Recording is a few relaxed atomic adds, so it can be shared by every thread.
+struct ProfileStageStats {
+	std::atomic<uint64_t> buckets[PROFILE_BUCKET_COUNT];
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> totalNsec{ 0 };
+	std::atomic<uint64_t> maxNsec{ 0 };
+	std::atomic<uint64_t> firstStartNsec{ UINT64_MAX };
+	std::atomic<uint64_t> lastEndNsec{ 0 };
+
+	ProfileStageStats() {
+		for (int i = 0; i < PROFILE_BUCKET_COUNT; i++) {
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void record(uint64_t startNsec, uint64_t endNsec) {
+		uint64_t nsec = endNsec > startNsec ? endNsec - startNsec : 0;
+		buckets[profileBucket(nsec)].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		totalNsec.fetch_add(nsec, std::memory_order_relaxed);
+
+		uint64_t previous = maxNsec.load(std::memory_order_relaxed);
+		while (nsec > previous && !maxNsec.compare_exchange_weak(previous, nsec, std::memory_order_relaxed)) {}
+		previous = firstStartNsec.load(std::memory_order_relaxed);
+		while (startNsec < previous && !firstStartNsec.compare_exchange_weak(previous, startNsec, std::memory_order_relaxed)) {}
+		previous = lastEndNsec.load(std::memory_order_relaxed);
+		while (endNsec > previous && !lastEndNsec.compare_exchange_weak(previous, endNsec, std::memory_order_relaxed)) {}
+	}
+
+	//Upper edge of the bucket holding the given fraction of samples, capped at the true maximum
+	uint64_t percentileNsec(double fraction) const {
+		uint64_t total = count.load(std::memory_order_relaxed);
+		if (total == 0) {
+			return 0;
+		}
+		uint64_t target = (uint64_t)(fraction * total + 0.5);
+		if (target < 1) {
+			target = 1;
+		}
+		uint64_t seen = 0;
+		for (int i = 0; i < PROFILE_BUCKET_COUNT; i++) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target) {
+				uint64_t upper = i + 1 < PROFILE_BUCKET_COUNT ? profileBucketLowerBound(i + 1) - 1 : UINT64_MAX;
+				uint64_t maximum = maxNsec.load(std::memory_order_relaxed);
+				return upper < maximum ? upper : maximum;
+			}
+		}
+		return maxNsec.load(std::memory_order_relaxed);
+	}
+
+	//Samples per second over the span the stage was active
+	double framesPerSecond() const {
+		uint64_t first = firstStartNsec.load(std::memory_order_relaxed);
+		uint64_t last = lastEndNsec.load(std::memory_order_relaxed);
+		if (last <= first) {
+			return 0;
+		}
+		return count.load(std::memory_order_relaxed) / ((last - first) / 1e9);
+	}
+};
+
+ProfileStageStats profileStages[STAGE_COUNT];
+
+//Every sample also becomes a complete event on the trace timeline when tracing is on
+void recordProfileStage(ProfileStage stage, uint64_t startNsec, uint64_t endNsec) {
+	profileStages[stage].record(startNsec, endNsec);
+	traceComplete(profileStageNames[stage], startNsec, endNsec);
+}
+
+//Times the enclosing scope into a stage. cancel() skips the sample, for calls that timed out or failed.
+class ScopedTimer {
+public:
+	ScopedTimer(ProfileStage stage) : m_stage(stage), m_startNsec(profileNowNsec()) {}
+
+	~ScopedTimer() {
+		if (m_active) {
+			recordProfileStage(m_stage, m_startNsec, profileNowNsec());
+		}
+	}
+
+	void cancel() {
+		m_active = false;
+	}
+
+private:
+	ProfileStage m_stage;
+	uint64_t m_startNsec;
+	bool m_active = true;
+};
+
+//Prints a table of every stage that recorded samples
+void printProfileReport() {
+	bool header = false;
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		const ProfileStageStats& stats = profileStages[i];
+		uint64_t count = stats.count.load(std::memory_order_relaxed);
+		if (count == 0) {
+			continue;
+		}
+		if (!header) {
+			std::printf("%-16s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "frames/s", "mean ms", "p50 ms", "p99 ms", "max ms");
+			header = true;
+		}
+		std::printf("%-16s %10llu %10.1f %10.3f %10.3f %10.3f %10.3f\n", profileStageNames[i], (unsigned long long)count,
+			stats.framesPerSecond(), stats.totalNsec.load(std::memory_order_relaxed) / 1e6 / count,
+			stats.percentileNsec(0.5) / 1e6, stats.percentileNsec(0.99) / 1e6, stats.maxNsec.load(std::memory_order_relaxed) / 1e6);
+	}
+}
+
+//Writes every stage that recorded samples as JSON, returns false if the file could not be written
+bool writeProfileJson(const std::string& path) {
+	std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << "{\n\t\"stages\": [";
+	bool first = true;
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		const ProfileStageStats& stats = profileStages[i];
+		uint64_t count = stats.count.load(std::memory_order_relaxed);
+		if (count == 0) {
+			continue;
+		}
+		file << (first ? "\n" : ",\n");
+		first = false;
+		file << "\t\t{ \"name\": \"" << profileStageNames[i] << "\", \"count\": " << count
+			<< ", \"framesPerSecond\": " << stats.framesPerSecond()
+			<< ", \"meanMs\": " << stats.totalNsec.load(std::memory_order_relaxed) / 1e6 / count
+			<< ", \"p50Ms\": " << stats.percentileNsec(0.5) / 1e6
+			<< ", \"p99Ms\": " << stats.percentileNsec(0.99) / 1e6
+			<< ", \"maxMs\": " << stats.maxNsec.load(std::memory_order_relaxed) / 1e6 << " }";
+	}
+	file << "\n\t]\n}\n";
+	return file.good();
+}
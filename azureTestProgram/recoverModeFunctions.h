@@ -0,0 +1,67 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "exportFunctions.h"
+#include "checkerFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <experimental/filesystem>
+
+//Cuts a journal left open by a crash back to its last whole frame and writes the timestamp index and header a
+//clean close would have written. Returns false if the journal cannot be rewritten.
+bool sealSkeletonJournal(const std::string& journal_path, SkelFileHeader header, const std::vector<uint64_t>& timestamps) {
+	std::error_code error;
+	std::experimental::filesystem::resize_file(journal_path, header.headerSize + timestamps.size() * header.recordSize, error);
+	if (error) {
+		return false;
+	}
+	std::fstream file(journal_path, std::ios::in | std::ios::out | std::ios::binary);
+	return file.is_open() && finishSkelFile(file, &header, timestamps);
+}
+
+//Turns the journal of a recording that failed or crashed into an output file, and seals the journal so it reads like
+//any closed .skel file afterwards
+std::string recoverModeFunction(const char* journal_path, const char* output_path, const ExportOptions& options) {
+	std::string errorMessage = "";
+
+	//Check output file existence
+	if (fileExists(output_path)) {
+		return "Output file already exists, please choose another name.\n";
+	}
+
+	//Map the journal, one without an index counts every whole frame record
+	SkelFileReader reader;
+	errorMessage += reader.open(journal_path);
+	if (errorMessage == "" && reader.frameCount() == 0) {
+		errorMessage += "Journal has no frames to recover.\n";
+	}
+	if (errorMessage != "") {
+		return errorMessage;
+	}
+
+	SkeletonTrack track;
+	reader.readAll(&track);
+	SkelFileHeader header = reader.header();
+	bool sealed = reader.indexed();
+	reader.close();
+
+	double seconds = (track.timestamps().back() - track.timestamps().front()) / 1000000.0;
+	std::cout << "Recovered " << track.size() << " frames (" << seconds << " s)"
+		<< (sealed ? ", the journal was closed cleanly" : "") << std::endl;
+
+	//Seal the journal before exporting, so the frames are safe even if the export fails too
+	if (!sealed && !sealSkeletonJournal(journal_path, header, track.timestamps())) {
+		std::cout << "Could not seal the journal, it is left unchanged." << std::endl;
+	}
+
+	//Create FBX, GLTF or SKEL from the recovered frames
+	errorMessage += exportSkeletons(track, output_path, options, header.hasCalibration ? &header.calibration : NULL);
+
+	return errorMessage;
+}
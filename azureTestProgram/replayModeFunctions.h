@@ -0,0 +1,37 @@
+#pragma once
+
+#include <k4a/k4a.h>
+#include <k4arecord/playback.h>
+#include <k4abt.h>
+
+#include "realtimeModeFunctions.h"
+#include "captureSourceFunctions.h"
+
+#include <string>
+#include <chrono>
+#include <iostream>
+
+#define REPLAY_DEFAULT_SPEED 1.0
+
+//Feeds a recording through the realtime pipeline paced by its device timestamps, so the live path can be measured without a Kinect.
+//speed scales the pacing, 2 plays back twice as fast as it was recorded.
+std::string replayModeFunction(const char* input_path, const char* output_path, const ExportOptions& options, UdpTransmitSocket* transmitSocket, double speed = REPLAY_DEFAULT_SPEED,
+	bool unbounded = false, OverloadPolicy overloadPolicy = OVERLOAD_BLOCK, int dropEvery = 2) {
+	if (speed <= 0) {
+		return "Replay speed must be greater than zero.\n";
+	}
+
+	PlaybackCaptureSource playback(input_path, speed);
+	TrackedSkeletonSource source(&playback, overloadPolicy, dropEvery, unbounded ? 0 : REALTIME_MAX_FRAMES);
+
+	auto start = std::chrono::steady_clock::now();
+	std::string errorMessage = recordSkeletonSource(&source, output_path, options, transmitSocket);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (errorMessage == "") {
+		std::cout << "Replayed at " << speed << "x, tracked " << source.trackedFrames() << " frames in " << elapsed.count() << " s ("
+			<< (elapsed.count() > 0 ? source.trackedFrames() / elapsed.count() : 0) << " frames/sec, max pacing lag "
+			<< playback.maxLagUsec() / 1000.0 << " ms)" << std::endl;
+	}
+	return errorMessage;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//Lock-free ring buffer for exactly one producer thread and one consumer thread.
+//Capacity must be a power of two. Indices only ever increase, so full and empty are never ambiguous.
+template<typename T, size_t Capacity>
+class SpscRing {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+	//Producer side, returns false without blocking when the ring is full
+	bool push(const T& item) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= Capacity) {
+			return false;
+		}
+		m_items[tail & (Capacity - 1)] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer side, returns false without blocking when the ring is empty
+	bool pop(T* item) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		*item = m_items[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Approximate when called while the other side is running
+	size_t size() const {
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const {
+		return Capacity;
+	}
+
+private:
+	T m_items[Capacity];
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+};
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <k4a/k4a.h>
+#include <k4abt.h>
+
+#include "skeletonTrackFunctions.h"
+
+#ifdef _WIN32
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+//.skel files hold tracked skeletons between the tracker and the exporters:
+//	header | fixed-stride frame records | timestamp index
+//The header is rewritten with the frame count and index offset when a writer closes. A file whose writer never
+//closed has no index, readers then derive the frame count from the file size and search the records themselves.
+//All values are little-endian, as written by the x86/x64 builds of this program.
+#define SKEL_MAGIC "SKEL"
+#define SKEL_VERSION 1
+#define SKEL_DEFAULT_FPS 30
+
+struct SkelFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize;		//Offset of the first frame record
+	uint32_t recordSize;		//Stride of frame records
+	uint32_t jointCount;
+	uint32_t frameRate;
+	uint32_t hasCalibration;
+	uint32_t reserved;
+	uint64_t frameCount;		//0 until the writer closes
+	uint64_t indexOffset;		//Offset of frameCount timestamps, 0 until the writer closes
+	k4a_calibration_t calibration;
+};
+
+struct SkelJointRecord {
+	float position[3];			//xyz in millimetres
+	float orientation[4];		//wxyz
+	uint32_t confidence;		//k4abt_joint_confidence_level_t
+};
+
+struct SkelFrameRecord {
+	uint64_t timestampUsec;
+	SkelJointRecord joints[SKELETON_JOINT_COUNT];
+};
+
+void initSkelHeader(SkelFileHeader* header, const k4a_calibration_t* calibration, int frameRate) {
+	std::memset(header, 0, sizeof(SkelFileHeader));
+	std::memcpy(header->magic, SKEL_MAGIC, 4);
+	header->version = SKEL_VERSION;
+	header->headerSize = sizeof(SkelFileHeader);
+	header->recordSize = sizeof(SkelFrameRecord);
+	header->jointCount = SKELETON_JOINT_COUNT;
+	header->frameRate = frameRate > 0 ? frameRate : SKEL_DEFAULT_FPS;
+	if (calibration != NULL) {
+		header->hasCalibration = 1;
+		header->calibration = *calibration;
+	}
+}
+
+void toSkelFrameRecord(const k4abt_skeleton_t& skeleton, uint64_t timestampUsec, SkelFrameRecord* record) {
+	record->timestampUsec = timestampUsec;
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+		const k4abt_joint_t& joint = skeleton.joints[i];
+		SkelJointRecord& out = record->joints[i];
+		out.position[0] = joint.position.xyz.x;
+		out.position[1] = joint.position.xyz.y;
+		out.position[2] = joint.position.xyz.z;
+		out.orientation[0] = joint.orientation.wxyz.w;
+		out.orientation[1] = joint.orientation.wxyz.x;
+		out.orientation[2] = joint.orientation.wxyz.y;
+		out.orientation[3] = joint.orientation.wxyz.z;
+		out.confidence = (uint32_t)joint.confidence_level;
+	}
+}
+
+void fromSkelFrameRecord(const SkelFrameRecord& record, k4abt_skeleton_t* skeleton) {
+	*skeleton = k4abt_skeleton_t();
+	for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+		const SkelJointRecord& in = record.joints[i];
+		k4abt_joint_t& joint = skeleton->joints[i];
+		joint.position.xyz.x = in.position[0];
+		joint.position.xyz.y = in.position[1];
+		joint.position.xyz.z = in.position[2];
+		joint.orientation.wxyz.w = in.orientation[0];
+		joint.orientation.wxyz.x = in.orientation[1];
+		joint.orientation.wxyz.y = in.orientation[2];
+		joint.orientation.wxyz.z = in.orientation[3];
+		joint.confidence_level = (k4abt_joint_confidence_level_t)in.confidence;
+	}
+}
+
+//Writes the timestamp index after the last record and rewrites the header so readers can use it
+bool finishSkelFile(std::fstream& file, SkelFileHeader* header, const std::vector<uint64_t>& timestamps) {
+	file.seekp(0, std::ios::end);
+	header->frameCount = timestamps.size();
+	header->indexOffset = (uint64_t)file.tellp();
+	file.write((const char*)timestamps.data(), static_cast<std::streamsize>(timestamps.size() * sizeof(uint64_t)));
+	file.seekp(0, std::ios::beg);
+	file.write((const char*)header, sizeof(SkelFileHeader));
+	file.flush();
+	return file.good();
+}
+
+//Writes a whole track to a .skel file
+bool writeSkelFile(const SkeletonTrack& track, const char* output_path, const k4a_calibration_t* calibration = NULL, int frameRate = SKEL_DEFAULT_FPS) {
+	std::fstream file(output_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	SkelFileHeader header;
+	initSkelHeader(&header, calibration, frameRate);
+	file.write((const char*)&header, sizeof(SkelFileHeader));
+
+	SkelFrameRecord record;
+	for (size_t i = 0; i < track.size(); i++) {
+		toSkelFrameRecord(track.skeleton(i), track.timestamps()[i], &record);
+		file.write((const char*)&record, sizeof(SkelFrameRecord));
+	}
+	return file.good() && finishSkelFile(file, &header, track.timestamps());
+}
+
+//Maps a .skel file read-only. Frames are read straight out of the mapping, so opening costs the same for any file size.
+class SkelFileReader {
+public:
+	~SkelFileReader() {
+		close();
+	}
+
+	//Returns an error message, empty on success
+	std::string open(const std::string& path) {
+		close();
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_file == INVALID_HANDLE_VALUE) {
+			return "Cannot open skeleton file.\n";
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(m_file, &fileSize);
+		m_size = (size_t)fileSize.QuadPart;
+		if (m_size >= sizeof(SkelFileHeader)) {
+			m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (m_mapping != NULL) {
+				m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			}
+		}
+#else
+		m_file = ::open(path.c_str(), O_RDONLY);
+		if (m_file < 0) {
+			return "Cannot open skeleton file.\n";
+		}
+		struct stat fileStat;
+		fstat(m_file, &fileStat);
+		m_size = (size_t)fileStat.st_size;
+		if (m_size >= sizeof(SkelFileHeader)) {
+			void* data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+			m_data = data == MAP_FAILED ? NULL : (const uint8_t*)data;
+		}
+#endif
+		if (m_data == NULL) {
+			close();
+			return "Cannot map skeleton file.\n";
+		}
+
+		//Check the header
+		const SkelFileHeader& fileHeader = header();
+		if (std::memcmp(fileHeader.magic, SKEL_MAGIC, 4) != 0 || fileHeader.version != SKEL_VERSION) {
+			close();
+			return "Not a skeleton file.\n";
+		}
+		if (fileHeader.jointCount != SKELETON_JOINT_COUNT || fileHeader.recordSize != sizeof(SkelFrameRecord) || fileHeader.headerSize > m_size) {
+			close();
+			return "Unsupported skeleton file layout.\n";
+		}
+
+		//Use the index when the writer finished, otherwise every complete record counts
+		if (fileHeader.indexOffset != 0 && fileHeader.indexOffset + fileHeader.frameCount * sizeof(uint64_t) <= m_size) {
+			m_frameCount = (size_t)fileHeader.frameCount;
+			m_index = (const uint64_t*)(m_data + fileHeader.indexOffset);
+		}
+		else {
+			m_frameCount = (m_size - fileHeader.headerSize) / fileHeader.recordSize;
+			m_index = NULL;
+		}
+		return "";
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (m_data != NULL) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping != NULL) {
+			CloseHandle(m_mapping);
+			m_mapping = NULL;
+		}
+		if (m_file != INVALID_HANDLE_VALUE) {
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (m_data != NULL) {
+			munmap((void*)m_data, m_size);
+		}
+		if (m_file >= 0) {
+			::close(m_file);
+			m_file = -1;
+		}
+#endif
+		m_data = NULL;
+		m_index = NULL;
+		m_size = 0;
+		m_frameCount = 0;
+	}
+
+	const SkelFileHeader& header() const {
+		return *(const SkelFileHeader*)m_data;
+	}
+
+	const k4a_calibration_t* calibration() const {
+		return header().hasCalibration ? &header().calibration : NULL;
+	}
+
+	size_t frameCount() const {
+		return m_frameCount;
+	}
+
+	bool indexed() const {
+		return m_index != NULL;
+	}
+
+	const SkelFrameRecord& frame(size_t frameIndex) const {
+		return *(const SkelFrameRecord*)(m_data + header().headerSize + frameIndex * header().recordSize);
+	}
+
+	uint64_t timestampAt(size_t frameIndex) const {
+		return m_index != NULL ? m_index[frameIndex] : frame(frameIndex).timestampUsec;
+	}
+
+	//Index of the first frame at or after timestampUsec, binary searched in the index or the records
+	size_t findFrame(uint64_t timestampUsec) const {
+		size_t low = 0;
+		size_t high = m_frameCount;
+		while (low < high) {
+			size_t middle = low + (high - low) / 2;
+			if (timestampAt(middle) < timestampUsec) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		return low;
+	}
+
+	//Appends frames with startUsec <= timestamp < endUsec to track
+	void readRange(uint64_t startUsec, uint64_t endUsec, SkeletonTrack* track) const {
+		size_t first = findFrame(startUsec);
+		size_t last = endUsec == UINT64_MAX ? m_frameCount : findFrame(endUsec);
+		if (last <= first) {
+			return;
+		}
+		track->reserve(track->size() + (last - first));
+		k4abt_skeleton_t skeleton;
+		for (size_t i = first; i < last; i++) {
+			const SkelFrameRecord& record = frame(i);
+			fromSkelFrameRecord(record, &skeleton);
+			track->append(skeleton, record.timestampUsec);
+		}
+	}
+
+	void readAll(SkeletonTrack* track) const {
+		readRange(0, UINT64_MAX, track);
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = NULL;
+#else
+	int m_file = -1;
+#endif
+	const uint8_t* m_data = NULL;
+	const uint64_t* m_index = NULL;
+	size_t m_size = 0;
+	size_t m_frameCount = 0;
+};
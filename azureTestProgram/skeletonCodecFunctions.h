@@ -0,0 +1,317 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+//Compressed skeleton sequences (.skelz). Every value is predicted from the same joint in the previous frame
+//and only the zigzag varint coded difference is stored:
+//	positions are fixed point at positionPrecisionMm, with the 2 bit confidence folded into the x difference
+//	orientations are smallest-three quaternions: the largest component is dropped (its sign made positive, which
+//	gives the same rotation) and the other three are quantised to orientationBits, with the 2 bit index of the
+//	dropped component folded into the first difference
+//	timestamps are differences from the previous frame
+//Frames are stored one after another so a sequence can be decoded front to back into a track.
+#define SKELETON_CODEC_MAGIC "SKCZ"
+#define SKELETON_CODEC_VERSION 1
+#define SKELETON_CODEC_DEFAULT_PRECISION_MM 0.1f
+#define SKELETON_CODEC_DEFAULT_ORIENTATION_BITS 12
+
+struct SkeletonCodecSettings {
+	float positionPrecisionMm = SKELETON_CODEC_DEFAULT_PRECISION_MM;
+	int orientationBits = SKELETON_CODEC_DEFAULT_ORIENTATION_BITS;
+};
+
+void writeVarint(std::vector<uint8_t>* out, uint64_t value) {
+	while (value >= 0x80) {
+		out->push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out->push_back((uint8_t)value);
+}
+
+//Returns false when the input ends in the middle of a value
+bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t* value) {
+	uint64_t result = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7) {
+		uint8_t byte = *data++;
+		result |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t zigzagEncode(int64_t value) {
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//Quantises a wxyz quaternion to the index of its largest component and the other three in order
+void encodeSmallestThree(const float* wxyz, int bits, int* largest, int32_t quantised[3]) {
+	int index = 0;
+	for (int i = 1; i < 4; i++) {
+		if (std::fabs(wxyz[i]) > std::fabs(wxyz[index])) {
+			index = i;
+		}
+	}
+	float sign = wxyz[index] < 0 ? -1.0f : 1.0f;
+	float scale = (float)((1 << (bits - 1)) - 1) * 1.41421356f;
+	for (int i = 0, j = 0; i < 4; i++) {
+		if (i != index) {
+			quantised[j++] = (int32_t)std::lround(wxyz[i] * sign * scale);
+		}
+	}
+	*largest = index;
+}
+
+void decodeSmallestThree(int largest, const int32_t quantised[3], int bits, float* wxyz) {
+	float scale = 1.0f / ((float)((1 << (bits - 1)) - 1) * 1.41421356f);
+	float sum = 0;
+	for (int i = 0, j = 0; i < 4; i++) {
+		if (i != largest) {
+			wxyz[i] = quantised[j++] * scale;
+			sum += wxyz[i] * wxyz[i];
+		}
+	}
+	wxyz[largest] = sum < 1.0f ? std::sqrt(1.0f - sum) : 0.0f;
+}
+
+//Previous frame values every joint is predicted from
+struct SkeletonCodecState {
+	uint64_t timestampUsec = 0;
+	int32_t position[SKELETON_JOINT_COUNT][3];
+	int32_t orientation[SKELETON_JOINT_COUNT][3];
+
+	SkeletonCodecState() {
+		std::memset(position, 0, sizeof(position));
+		std::memset(orientation, 0, sizeof(orientation));
+	}
+};
+
+void encodeSkeletonTrack(const SkeletonTrack& track, const SkeletonCodecSettings& settings, std::vector<uint8_t>* out) {
+	out->clear();
+	out->reserve(track.size() * SKELETON_JOINT_COUNT * 8 + 64);
+
+	//Header
+	out->insert(out->end(), SKELETON_CODEC_MAGIC, SKELETON_CODEC_MAGIC + 4);
+	out->push_back(SKELETON_CODEC_VERSION);
+	out->push_back(SKELETON_JOINT_COUNT);
+	out->push_back((uint8_t)settings.orientationBits);
+	uint32_t precisionBits;
+	std::memcpy(&precisionBits, &settings.positionPrecisionMm, sizeof(float));
+	writeVarint(out, precisionBits);
+	writeVarint(out, track.size());
+
+	float inversePrecision = 1.0f / settings.positionPrecisionMm;
+	SkeletonCodecState previous;
+	for (size_t frame = 0; frame < track.size(); frame++) {
+		uint64_t timestamp = track.timestamps()[frame];
+		writeVarint(out, zigzagEncode((int64_t)(timestamp - previous.timestampUsec)));
+		previous.timestampUsec = timestamp;
+
+		for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+			const float* position = &track.positions(joint)[frame * 3];
+			int32_t* previousPosition = previous.position[joint];
+			for (int axis = 0; axis < 3; axis++) {
+				int32_t value = (int32_t)std::lround(position[axis] * inversePrecision);
+				uint64_t delta = zigzagEncode((int64_t)value - previousPosition[axis]);
+				if (axis == 0) {
+					delta = (delta << 2) | (track.confidence(joint)[frame] & 3);
+				}
+				writeVarint(out, delta);
+				previousPosition[axis] = value;
+			}
+
+			int largest;
+			int32_t quantised[3];
+			encodeSmallestThree(&track.orientations(joint)[frame * 4], settings.orientationBits, &largest, quantised);
+			int32_t* previousOrientation = previous.orientation[joint];
+			for (int i = 0; i < 3; i++) {
+				uint64_t delta = zigzagEncode((int64_t)quantised[i] - previousOrientation[i]);
+				if (i == 0) {
+					delta = (delta << 2) | (uint64_t)largest;
+				}
+				writeVarint(out, delta);
+				previousOrientation[i] = quantised[i];
+			}
+		}
+	}
+}
+
+//Appends the decoded frames to track, returns an error message, empty on success
+std::string decodeSkeletonTrack(const uint8_t* data, size_t size, SkeletonTrack* track) {
+	const uint8_t* end = data + size;
+	if (size < 7 || std::memcmp(data, SKELETON_CODEC_MAGIC, 4) != 0) {
+		return "Not a compressed skeleton file.\n";
+	}
+	if (data[4] != SKELETON_CODEC_VERSION || data[5] != SKELETON_JOINT_COUNT) {
+		return "Unsupported compressed skeleton version.\n";
+	}
+	int orientationBits = data[6];
+	data += 7;
+
+	uint64_t precisionBits, frameCount;
+	if (!readVarint(data, end, &precisionBits) || !readVarint(data, end, &frameCount) || orientationBits < 2 || orientationBits > 30) {
+		return "Compressed skeleton header is damaged.\n";
+	}
+	float precision;
+	uint32_t precisionBits32 = (uint32_t)precisionBits;
+	std::memcpy(&precision, &precisionBits32, sizeof(float));
+
+	//Every frame takes at least one byte per value, which bounds the reservation for damaged headers
+	size_t minimumFrameBytes = 1 + SKELETON_JOINT_COUNT * 6;
+	track->reserve(track->size() + (size_t)std::min<uint64_t>(frameCount, (uint64_t)(end - data) / minimumFrameBytes));
+
+	SkeletonCodecState previous;
+	k4abt_skeleton_t skeleton = k4abt_skeleton_t();
+	for (uint64_t frame = 0; frame < frameCount; frame++) {
+		uint64_t value;
+		if (!readVarint(data, end, &value)) {
+			return "Compressed skeleton data is truncated.\n";
+		}
+		previous.timestampUsec += (uint64_t)zigzagDecode(value);
+
+		for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+			k4abt_joint_t& outJoint = skeleton.joints[joint];
+			int32_t* previousPosition = previous.position[joint];
+			for (int axis = 0; axis < 3; axis++) {
+				if (!readVarint(data, end, &value)) {
+					return "Compressed skeleton data is truncated.\n";
+				}
+				if (axis == 0) {
+					outJoint.confidence_level = (k4abt_joint_confidence_level_t)(value & 3);
+					value >>= 2;
+				}
+				previousPosition[axis] += (int32_t)zigzagDecode(value);
+				outJoint.position.v[axis] = previousPosition[axis] * precision;
+			}
+
+			int largest = 0;
+			int32_t* previousOrientation = previous.orientation[joint];
+			for (int i = 0; i < 3; i++) {
+				if (!readVarint(data, end, &value)) {
+					return "Compressed skeleton data is truncated.\n";
+				}
+				if (i == 0) {
+					largest = (int)(value & 3);
+					value >>= 2;
+				}
+				previousOrientation[i] += (int32_t)zigzagDecode(value);
+			}
+			decodeSmallestThree(largest, previousOrientation, orientationBits, outJoint.orientation.v);
+		}
+		track->append(skeleton, previous.timestampUsec);
+	}
+	return "";
+}
+
+
+//Returns an error message for settings the codec cannot store or decode faithfully, empty if they are usable
+std::string checkSkeletonCodecSettings(const SkeletonCodecSettings& settings) {
+	if (!(settings.positionPrecisionMm > 0) || settings.orientationBits < 4 || settings.orientationBits > 24) {
+		return "Codec precision must be positive and orientation bits between 4 and 24.\n";
+	}
+	return "";
+}
+
+//Largest position error the settings allow: half a step plus float rounding of positions a few metres from the sensor
+double skeletonCodecPositionTolerance(const SkeletonCodecSettings& settings) {
+	return settings.positionPrecisionMm * 0.5 + 0.01;
+}
+
+//Largest rotation error the settings allow. Each kept component is off by at most half a step, which moves the
+//rebuilt largest component by at most three times that, so the quaternions are at most sqrt(3) steps apart.
+double skeletonCodecOrientationTolerance(const SkeletonCodecSettings& settings) {
+	double step = 1.0 / (((1 << (settings.orientationBits - 1)) - 1) * 1.41421356);
+	return 4.0 * std::asin(std::min(std::sqrt(3.0) * step * 0.5, 1.0)) * 180.0 / 3.14159265358979 + 0.01;
+}
+
+//Largest difference between a track and its decoded copy, positions in millimetres and orientations in degrees.
+//The rotation angle is taken from the chord between the normalised quaternions, since acos loses small angles.
+void measureSkeletonCodecError(const SkeletonTrack& track, const SkeletonTrack& decoded, double* maxPositionErrorMm, double* maxOrientationErrorDegrees) {
+	*maxPositionErrorMm = 0;
+	*maxOrientationErrorDegrees = 0;
+	for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+		const std::vector<float>& positions = track.positions(joint);
+		const std::vector<float>& decodedPositions = decoded.positions(joint);
+		for (size_t i = 0; i < positions.size() && i < decodedPositions.size(); i++) {
+			*maxPositionErrorMm = std::max(*maxPositionErrorMm, (double)std::fabs(positions[i] - decodedPositions[i]));
+		}
+		const std::vector<float>& orientations = track.orientations(joint);
+		const std::vector<float>& decodedOrientations = decoded.orientations(joint);
+		for (size_t i = 0; i + 3 < orientations.size() && i + 3 < decodedOrientations.size(); i += 4) {
+			double originalLength = 0, decodedLength = 0, dot = 0;
+			for (int c = 0; c < 4; c++) {
+				originalLength += (double)orientations[i + c] * orientations[i + c];
+				decodedLength += (double)decodedOrientations[i + c] * decodedOrientations[i + c];
+				dot += (double)orientations[i + c] * decodedOrientations[i + c];
+			}
+			if (originalLength <= 0 || decodedLength <= 0) {
+				continue;
+			}
+			double chord = 0;
+			for (int c = 0; c < 4; c++) {
+				double difference = orientations[i + c] / std::sqrt(originalLength) - (dot < 0 ? -1 : 1) * decodedOrientations[i + c] / std::sqrt(decodedLength);
+				chord += difference * difference;
+			}
+			*maxOrientationErrorDegrees = std::max(*maxOrientationErrorDegrees, 4.0 * std::asin(std::min(std::sqrt(chord) * 0.5, 1.0)) * 180.0 / 3.14159265358979);
+		}
+	}
+}
+
+//Encodes the track with settings and decodes it again before writing, so a file that would not hold the requested
+//precision is refused instead of written. Returns an error message, empty on success.
+std::string writeSkelzFile(const SkeletonTrack& track, const char* output_path, const SkeletonCodecSettings& settings = SkeletonCodecSettings()) {
+	std::string errorMessage = checkSkeletonCodecSettings(settings);
+	if (errorMessage != "") {
+		return errorMessage;
+	}
+	std::vector<uint8_t> encoded;
+	encodeSkeletonTrack(track, settings, &encoded);
+	SkeletonTrack decoded;
+	errorMessage = decodeSkeletonTrack(encoded.data(), encoded.size(), &decoded);
+	if (errorMessage != "") {
+		return errorMessage;
+	}
+	double maxPositionError, maxOrientationError;
+	measureSkeletonCodecError(track, decoded, &maxPositionError, &maxOrientationError);
+	if (maxPositionError > skeletonCodecPositionTolerance(settings) || maxOrientationError > skeletonCodecOrientationTolerance(settings)) {
+		std::ostringstream message;
+		message << "Compressed skeletons are off by " << maxPositionError << " mm and " << maxOrientationError << " degrees, more than "
+			<< settings.positionPrecisionMm << " mm precision and " << settings.orientationBits << " bit orientations allow.\n";
+		return message.str();
+	}
+
+	std::ofstream file(output_path, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write((const char*)encoded.data(), static_cast<std::streamsize>(encoded.size()));
+	return file.good() ? "" : "An error occurred while creating the skelz.\n";
+}
+
+std::string readSkelzFile(const char* input_path, SkeletonTrack* track) {
+	std::ifstream file(input_path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return "Cannot open compressed skeleton file.\n";
+	}
+	std::vector<uint8_t> encoded((size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read((char*)encoded.data(), static_cast<std::streamsize>(encoded.size()));
+	if (file.fail()) {
+		return "Cannot read compressed skeleton file.\n";
+	}
+	return decodeSkeletonTrack(encoded.data(), encoded.size(), track);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "traceFunctions.h"
+#include "skeletonTrackFunctions.h"
+#include "skelFileFunctions.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define SKELETON_LOG_CHUNK_FRAMES 300
+#define SKELETON_LOG_COMMIT_MS 200
+
+//Appends skeletons to a .skel file during capture, which doubles as a crash-safe journal of the session. Frames are
+//collected into chunks on the capture thread, which hands a chunk over when it is full or SKELETON_LOG_COMMIT_MS
+//after its first frame. A background thread group-commits every chunk queued since its last pass with one write
+//and one flush, so the capture thread never touches the disk, a crash loses at most the last commit interval, and
+//only the 8 byte per frame timestamp index stays in memory however long a session runs. Records are fixed size and
+//append-only, so a file cut off by a crash still reads up to its last whole frame. The index and final header are
+//written on close.
+class SkeletonLogWriter {
+public:
+	~SkeletonLogWriter() {
+		close();
+	}
+
+	bool open(const std::string& path, const k4a_calibration_t* calibration, int frameRate = SKEL_DEFAULT_FPS) {
+		m_file.open(path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!m_file.is_open()) {
+			return false;
+		}
+		initSkelHeader(&m_header, calibration, frameRate);
+		m_file.write((const char*)&m_header, sizeof(SkelFileHeader));
+		m_timestamps.clear();
+		m_closing = false;
+		m_failed = false;
+		m_frameCount = 0;
+		m_chunk.reserve(SKELETON_LOG_CHUNK_FRAMES);
+		m_chunkStart = std::chrono::steady_clock::now();
+		m_thread = std::thread(&SkeletonLogWriter::writerLoop, this);
+		return true;
+	}
+
+	//Called from the capture thread, only takes the lock when a chunk is handed over
+	void append(const k4abt_skeleton_t& skeleton, uint64_t timestampUsec) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (m_chunk.empty()) {
+			m_chunkStart = now;
+		}
+		SkelFrameRecord record;
+		toSkelFrameRecord(skeleton, timestampUsec, &record);
+		m_chunk.push_back(record);
+		m_timestamps.push_back(timestampUsec);
+		m_frameCount++;
+		if (m_chunk.size() >= SKELETON_LOG_CHUNK_FRAMES || now - m_chunkStart >= std::chrono::milliseconds(SKELETON_LOG_COMMIT_MS)) {
+			submitChunk();
+		}
+	}
+
+	//Writes any remaining frames and waits for the writer to finish, returns false if a write failed
+	bool close() {
+		if (!m_thread.joinable()) {
+			return !m_failed;
+		}
+		if (!m_chunk.empty()) {
+			submitChunk();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closing = true;
+		}
+		m_condition.notify_one();
+		m_thread.join();
+		if (!m_failed && !finishSkelFile(m_file, &m_header, m_timestamps)) {
+			m_failed = true;
+		}
+		m_file.close();
+		return !m_failed;
+	}
+
+	size_t frameCount() const {
+		return m_frameCount;
+	}
+
+private:
+	void submitChunk() {
+		std::vector<SkelFrameRecord> next;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending.push_back(std::move(m_chunk));
+			traceInstant("skeleton log chunk queued");
+			if (!m_freeChunks.empty()) {
+				next = std::move(m_freeChunks.back());
+				m_freeChunks.pop_back();
+			}
+		}
+		m_condition.notify_one();
+		next.clear();
+		next.reserve(SKELETON_LOG_CHUNK_FRAMES);
+		m_chunk = std::move(next);
+	}
+
+	void writerLoop() {
+		setTraceThreadName("skeleton log writer");
+		std::deque<std::vector<SkelFrameRecord>> commit;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_condition.wait(lock, [this]() { return m_closing || !m_pending.empty(); });
+			if (m_pending.empty() && m_closing) {
+				break;
+			}
+			commit.swap(m_pending);
+
+			//Write and flush the whole group outside the lock so the capture thread never waits on the disk
+			lock.unlock();
+			traceBegin("skeleton log commit");
+			for (size_t i = 0; i < commit.size(); i++) {
+				m_file.write((const char*)commit[i].data(), static_cast<std::streamsize>(commit[i].size() * sizeof(SkelFrameRecord)));
+			}
+			m_file.flush();
+			bool writeFailed = !m_file.good();
+			traceEnd("skeleton log commit");
+			lock.lock();
+
+			if (writeFailed) {
+				m_failed = true;
+			}
+			while (!commit.empty()) {
+				m_freeChunks.push_back(std::move(commit.front()));
+				commit.pop_front();
+			}
+		}
+	}
+
+	std::fstream m_file;
+	SkelFileHeader m_header;
+	std::vector<uint64_t> m_timestamps;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<SkelFrameRecord> m_chunk;
+	std::chrono::steady_clock::time_point m_chunkStart;
+	std::deque<std::vector<SkelFrameRecord>> m_pending;
+	std::vector<std::vector<SkelFrameRecord>> m_freeChunks;
+	bool m_closing = false;
+	bool m_failed = false;
+	size_t m_frameCount = 0;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "skeletonTrackFunctions.h"
+
+#include <vector>
+#include <cmath>
+
+//Quaternions here are xyzw as glTF stores them, the track's wxyz orientations are converted when they are read
+
+void multiplyQuaternions(const float* a, const float* b, float* out) {
+	float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+	out[0] = x;
+	out[1] = y;
+	out[2] = z;
+	out[3] = w;
+}
+
+//Rotates v by the conjugate of unit quaternion q, which takes a vector from the space q rotates into back out of it
+void inverseRotateVector(const float* q, const float* v, float* out) {
+	//v' = v + 2w(t) + 2(u x t) with u = -q.xyz and t = u x v
+	float ux = -q[0], uy = -q[1], uz = -q[2], w = q[3];
+	float tx = uy * v[2] - uz * v[1];
+	float ty = uz * v[0] - ux * v[2];
+	float tz = ux * v[1] - uy * v[0];
+	out[0] = v[0] + 2 * (w * tx + uy * tz - uz * ty);
+	out[1] = v[1] + 2 * (w * ty + uz * tx - ux * tz);
+	out[2] = v[2] + 2 * (w * tz + ux * ty - uy * tx);
+}
+
+//Column-major inverse of the rigid transform that places a joint at position with rotation, as glTF skins expect
+void inverseBindMatrix(const float* position, const float* rotation, float* matrix) {
+	float x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+	//Rows of the rotation matrix, which are the columns of its inverse
+	float r[3][3] = {
+		{ 1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w) },
+		{ 2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w) },
+		{ 2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y) }
+	};
+	for (int column = 0; column < 3; column++) {
+		for (int row = 0; row < 3; row++) {
+			matrix[column * 4 + row] = r[column][row];
+		}
+		matrix[column * 4 + 3] = 0;
+	}
+	for (int row = 0; row < 3; row++) {
+		matrix[12 + row] = -(r[0][row] * position[0] + r[1][row] * position[1] + r[2][row] * position[2]);
+	}
+	matrix[15] = 1;
+}
+
+//Global and parent-relative pose of every joint in the frame the skin is bound to
+struct SkeletonBindPose {
+	bool valid = false;
+	float position[SKELETON_JOINT_COUNT][3];
+	float rotation[SKELETON_JOINT_COUNT][4];
+	float localTranslation[SKELETON_JOINT_COUNT][3];
+	float localRotation[SKELETON_JOINT_COUNT][4];
+};
+
+//Converts the tracker's camera space joint poses into poses relative to each joint's parent, the form glTF nodes
+//animate. Works a chunk at a time so streaming exporters can use it, and binds the skin to the first frame.
+class LocalPoseBuilder {
+public:
+	//Appends every frame of chunk to the per-joint translation (xyz) and rotation (xyzw) columns
+	void append(const SkeletonTrack& chunk, std::vector<float> translations[SKELETON_JOINT_COUNT], std::vector<float> rotations[SKELETON_JOINT_COUNT]) {
+		float position[SKELETON_JOINT_COUNT][3];
+		float rotation[SKELETON_JOINT_COUNT][4];
+		for (size_t frame = 0; frame < chunk.size(); frame++) {
+			for (int j = 0; j < SKELETON_JOINT_COUNT; j++) {
+				const float* p = &chunk.positions(j)[frame * 3];
+				const float* q = &chunk.orientations(j)[frame * 4];
+				float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+				float scale = length > 0 ? 1.0f / length : 0.0f;
+				position[j][0] = p[0];
+				position[j][1] = p[1];
+				position[j][2] = p[2];
+				rotation[j][0] = q[1] * scale;
+				rotation[j][1] = q[2] * scale;
+				rotation[j][2] = q[3] * scale;
+				rotation[j][3] = length > 0 ? q[0] * scale : 1.0f;
+			}
+
+			//Parents come before their children, so each frame is converted in joint order
+			float localTranslation[3];
+			float localRotation[4];
+			for (int j = 0; j < SKELETON_JOINT_COUNT; j++) {
+				toLocal(position, rotation, j, localTranslation, localRotation);
+
+				//q and -q are the same rotation, keep each joint in one hemisphere so interpolation takes the short way
+				float* previous = m_previousRotation[j];
+				if (m_started && previous[0] * localRotation[0] + previous[1] * localRotation[1] + previous[2] * localRotation[2] + previous[3] * localRotation[3] < 0) {
+					for (int c = 0; c < 4; c++) {
+						localRotation[c] = -localRotation[c];
+					}
+				}
+				for (int c = 0; c < 4; c++) {
+					previous[c] = localRotation[c];
+				}
+				translations[j].insert(translations[j].end(), localTranslation, localTranslation + 3);
+				rotations[j].insert(rotations[j].end(), localRotation, localRotation + 4);
+
+				if (!m_bindPose.valid) {
+					for (int c = 0; c < 3; c++) {
+						m_bindPose.position[j][c] = position[j][c];
+						m_bindPose.localTranslation[j][c] = localTranslation[c];
+					}
+					for (int c = 0; c < 4; c++) {
+						m_bindPose.rotation[j][c] = rotation[j][c];
+						m_bindPose.localRotation[j][c] = localRotation[c];
+					}
+				}
+			}
+			m_bindPose.valid = true;
+			m_started = true;
+		}
+	}
+
+	const SkeletonBindPose& bindPose() const {
+		return m_bindPose;
+	}
+
+private:
+	static void toLocal(const float position[][3], const float rotation[][4], int joint, float* localTranslation, float* localRotation) {
+		int parent = skeletonJointParents[joint];
+		if (parent < 0) {
+			for (int c = 0; c < 3; c++) {
+				localTranslation[c] = position[joint][c];
+			}
+			for (int c = 0; c < 4; c++) {
+				localRotation[c] = rotation[joint][c];
+			}
+			return;
+		}
+		float offset[3] = { position[joint][0] - position[parent][0], position[joint][1] - position[parent][1], position[joint][2] - position[parent][2] };
+		inverseRotateVector(rotation[parent], offset, localTranslation);
+		float parentInverse[4] = { -rotation[parent][0], -rotation[parent][1], -rotation[parent][2], rotation[parent][3] };
+		multiplyQuaternions(parentInverse, rotation[joint], localRotation);
+	}
+
+	SkeletonBindPose m_bindPose;
+	float m_previousRotation[SKELETON_JOINT_COUNT][4];
+	bool m_started = false;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//The exporters use the first 27 joints of the body tracking SDK
+#define SKELETON_JOINT_COUNT 27
+
+//Imported animations are resampled at the rate the exporters write keys
+#define IMPORT_FRAME_RATE 30
+
+//Files keep no confidence, imported joints are given the best level the tracker reports
+#define IMPORT_JOINT_CONFIDENCE K4ABT_JOINT_CONFIDENCE_MEDIUM
+
+//Joint names in body tracking SDK order, as they appear in exported files
+const char* skeletonJointNames[SKELETON_JOINT_COUNT] = {
+	"Pelvis", "Spine_Naval", "Spine_Chest", "Neck",
+	"Clavicle_Left", "Shoulder_Left", "Elbow_Left", "Wrist_Left", "Hand_Left", "Handtip_Left", "Thumb_Left",
+	"Clavical_Right", "Shoulder_Right", "Elbow_Right", "Wrist_Right", "Hand_Right", "Handtip_Right", "Thumb_Right",
+	"Hip_Left", "Knee_Left", "Ankle_Left", "Foot_Left",
+	"Hip_Right", "Knee_Right", "Ankle_Right", "Foot_Right",
+	"Head"
+};
+
+//Parent of every joint in the body tracking SDK's joint tree, -1 for the root. Thumbs hang off the wrist, not the
+//hand tip. Parents always come before their children.
+const int skeletonJointParents[SKELETON_JOINT_COUNT] = {
+	-1, 0, 1, 2,
+	2, 4, 5, 6, 7, 8, 7,
+	2, 11, 12, 13, 14, 15, 14,
+	0, 18, 19, 20,
+	0, 22, 23, 24,
+	3
+};
+
+//A recorded session stored joint-major: each joint has its own contiguous xyz position, wxyz orientation and
+//confidence columns, in the layout the exporters write them, plus one timestamp per frame. Frames are appended
+//in place while capturing and the whole track is handed to exporters by reference.
+class SkeletonTrack {
+public:
+	void reserve(size_t frameCount) {
+		m_timestamps.reserve(frameCount);
+		for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+			m_positions[i].reserve(frameCount * 3);
+			m_orientations[i].reserve(frameCount * 4);
+			m_confidence[i].reserve(frameCount);
+		}
+	}
+
+	void append(const k4abt_skeleton_t& skeleton, uint64_t timestampUsec) {
+		m_timestamps.push_back(timestampUsec);
+		for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+			const k4abt_joint_t& joint = skeleton.joints[i];
+			m_positions[i].push_back(joint.position.xyz.x);
+			m_positions[i].push_back(joint.position.xyz.y);
+			m_positions[i].push_back(joint.position.xyz.z);
+			m_orientations[i].push_back(joint.orientation.wxyz.w);
+			m_orientations[i].push_back(joint.orientation.wxyz.x);
+			m_orientations[i].push_back(joint.orientation.wxyz.y);
+			m_orientations[i].push_back(joint.orientation.wxyz.z);
+			m_confidence[i].push_back((uint8_t)joint.confidence_level);
+		}
+	}
+
+	//Appends every frame of another track, used to join tracks recorded in pieces
+	void append(const SkeletonTrack& other) {
+		m_timestamps.insert(m_timestamps.end(), other.m_timestamps.begin(), other.m_timestamps.end());
+		for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+			m_positions[i].insert(m_positions[i].end(), other.m_positions[i].begin(), other.m_positions[i].end());
+			m_orientations[i].insert(m_orientations[i].end(), other.m_orientations[i].begin(), other.m_orientations[i].end());
+			m_confidence[i].insert(m_confidence[i].end(), other.m_confidence[i].begin(), other.m_confidence[i].end());
+		}
+	}
+
+	//Rebuilds one frame, for code that still works a skeleton at a time
+	k4abt_skeleton_t skeleton(size_t frame) const {
+		k4abt_skeleton_t skeleton = k4abt_skeleton_t();
+		for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+			k4abt_joint_t& joint = skeleton.joints[i];
+			joint.position.xyz.x = m_positions[i][frame * 3];
+			joint.position.xyz.y = m_positions[i][frame * 3 + 1];
+			joint.position.xyz.z = m_positions[i][frame * 3 + 2];
+			joint.orientation.wxyz.w = m_orientations[i][frame * 4];
+			joint.orientation.wxyz.x = m_orientations[i][frame * 4 + 1];
+			joint.orientation.wxyz.y = m_orientations[i][frame * 4 + 2];
+			joint.orientation.wxyz.z = m_orientations[i][frame * 4 + 3];
+			joint.confidence_level = (k4abt_joint_confidence_level_t)m_confidence[i][frame];
+		}
+		return skeleton;
+	}
+
+	void clear() {
+		m_timestamps.clear();
+		for (int i = 0; i < SKELETON_JOINT_COUNT; i++) {
+			m_positions[i].clear();
+			m_orientations[i].clear();
+			m_confidence[i].clear();
+		}
+	}
+
+	size_t size() const {
+		return m_timestamps.size();
+	}
+
+	bool empty() const {
+		return m_timestamps.empty();
+	}
+
+	//xyz per frame in millimetres
+	const std::vector<float>& positions(int joint) const {
+		return m_positions[joint];
+	}
+
+	//wxyz per frame
+	const std::vector<float>& orientations(int joint) const {
+		return m_orientations[joint];
+	}
+
+	//k4abt_joint_confidence_level_t per frame
+	const std::vector<uint8_t>& confidence(int joint) const {
+		return m_confidence[joint];
+	}
+
+	//Device timestamp of every frame
+	const std::vector<uint64_t>& timestamps() const {
+		return m_timestamps;
+	}
+
+private:
+	std::vector<uint64_t> m_timestamps;
+	std::vector<float> m_positions[SKELETON_JOINT_COUNT];
+	std::vector<float> m_orientations[SKELETON_JOINT_COUNT];
+	std::vector<uint8_t> m_confidence[SKELETON_JOINT_COUNT];
+};
+
+//A named recording, as read back from files that hold several animations
+struct SkeletonTake {
+	std::string name;
+	SkeletonTrack track;
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+//Longest stretch one cubic segment may cover, which bounds the cost of fitting a still joint
+#define SPLINE_FIT_MAX_SEGMENT_FRAMES 256
+
+//Keys of a glTF CUBICSPLINE sampler fitted to a channel sampled every frame. values holds in-tangent, value and
+//out-tangent of every key, width floats each, with tangents in units per second as glTF expects.
+struct SplineChannel {
+	std::vector<float> times;
+	std::vector<float> values;
+	double maxError = 0;
+};
+
+//Hermite basis at s in [0, 1]
+void hermiteBasis(double s, double* h00, double* h10, double* h01, double* h11) {
+	double s2 = s * s, s3 = s2 * s;
+	*h00 = 2 * s3 - 3 * s2 + 1;
+	*h10 = s3 - 2 * s2 + s;
+	*h01 = -2 * s3 + 3 * s2;
+	*h11 = s3 - s2;
+}
+
+//Distance between a sample and the curve: euclidean for translations, the rotation angle in degrees between
+//the sample and the normalised curve for quaternions
+double splineSampleError(const float* sample, const double* curve, int width, bool rotation) {
+	if (!rotation) {
+		double distance = 0;
+		for (int c = 0; c < width; c++) {
+			distance += (curve[c] - sample[c]) * (curve[c] - sample[c]);
+		}
+		return std::sqrt(distance);
+	}
+	double curveLength = 0, sampleLength = 0, dot = 0;
+	for (int c = 0; c < 4; c++) {
+		curveLength += curve[c] * curve[c];
+		sampleLength += (double)sample[c] * sample[c];
+		dot += curve[c] * sample[c];
+	}
+	if (curveLength <= 0 || sampleLength <= 0) {
+		return 180.0;
+	}
+	double chord = 0;
+	for (int c = 0; c < 4; c++) {
+		double difference = sample[c] / std::sqrt(sampleLength) - (dot < 0 ? -1 : 1) * curve[c] / std::sqrt(curveLength);
+		chord += difference * difference;
+	}
+	return 4.0 * std::asin(std::min(std::sqrt(chord) * 0.5, 1.0)) * 180.0 / 3.14159265358979;
+}
+
+//Fits the out-tangent of frame a and the in-tangent of frame b by least squares over the frames between them, with
+//the key values fixed to the samples. The tangents are pulled slightly towards the chord so segments with one or no
+//frame inside stay well defined. Tangents are per segment, scaled by its duration; returns the largest error.
+double fitSplineSegment(const float* samples, size_t a, size_t b, int width, bool rotation, double* outTangent, double* inTangent) {
+	const double ridge = 1e-3;
+	double length = (double)(b - a);
+	double g00 = ridge, g01 = 0, g11 = ridge;
+	double r0[4], r1[4];
+	for (int c = 0; c < width; c++) {
+		double chord = samples[b * width + c] - samples[a * width + c];
+		r0[c] = ridge * chord;
+		r1[c] = ridge * chord;
+	}
+	double h00, h10, h01, h11;
+	for (size_t i = a + 1; i < b; i++) {
+		hermiteBasis((i - a) / length, &h00, &h10, &h01, &h11);
+		g00 += h10 * h10;
+		g01 += h10 * h11;
+		g11 += h11 * h11;
+		for (int c = 0; c < width; c++) {
+			double residual = samples[i * width + c] - h00 * samples[a * width + c] - h01 * samples[b * width + c];
+			r0[c] += h10 * residual;
+			r1[c] += h11 * residual;
+		}
+	}
+	double determinant = g00 * g11 - g01 * g01;
+	for (int c = 0; c < width; c++) {
+		outTangent[c] = (g11 * r0[c] - g01 * r1[c]) / determinant;
+		inTangent[c] = (g00 * r1[c] - g01 * r0[c]) / determinant;
+	}
+
+	double maxError = 0;
+	double curve[4];
+	for (size_t i = a + 1; i < b; i++) {
+		hermiteBasis((i - a) / length, &h00, &h10, &h01, &h11);
+		for (int c = 0; c < width; c++) {
+			curve[c] = h00 * samples[a * width + c] + h10 * outTangent[c] + h01 * samples[b * width + c] + h11 * inTangent[c];
+		}
+		maxError = std::max(maxError, splineSampleError(&samples[i * width], curve, width, rotation));
+	}
+	return maxError;
+}
+
+//Reduces a channel of frameCount samples, width floats each, to the fewest cubic segments found greedily whose curve
+//stays within tolerance of every sample. Each segment is grown by doubling and then bisecting its length. Rotations
+//are fitted component-wise like glTF runtimes interpolate them, with tolerance in degrees.
+void fitCubicSpline(const std::vector<float>& samples, size_t frameCount, int width, double frameSeconds, double tolerance, bool rotation, SplineChannel* spline) {
+	spline->times.clear();
+	spline->values.clear();
+	spline->maxError = 0;
+	if (frameCount == 0) {
+		return;
+	}
+
+	//Keys are added with no out-tangent, the segment after them fills it in
+	double outTangent[4], inTangent[4];
+	auto addKey = [&](size_t frame, const double* in, double seconds) {
+		spline->times.push_back((float)(frame * frameSeconds));
+		for (int c = 0; c < width; c++) {
+			spline->values.push_back(seconds > 0 ? (float)(in[c] / seconds) : 0.0f);
+		}
+		spline->values.insert(spline->values.end(), &samples[frame * width], &samples[frame * width] + width);
+		for (int c = 0; c < width; c++) {
+			spline->values.push_back(0.0f);
+		}
+	};
+	double noTangent[4] = { 0, 0, 0, 0 };
+	addKey(0, noTangent, 0);
+
+	size_t a = 0;
+	while (a + 1 < frameCount) {
+		size_t limit = std::min(frameCount - 1, a + SPLINE_FIT_MAX_SEGMENT_FRAMES);
+		size_t good = a + 1, bad = limit + 1;
+		for (size_t step = 2; ; step *= 2) {
+			size_t b = std::min(a + step, limit);
+			if (b <= good) {
+				break;
+			}
+			if (fitSplineSegment(samples.data(), a, b, width, rotation, outTangent, inTangent) <= tolerance) {
+				good = b;
+			}
+			else {
+				bad = b;
+				break;
+			}
+		}
+		while (bad - good > 1) {
+			size_t middle = (good + bad) / 2;
+			if (fitSplineSegment(samples.data(), a, middle, width, rotation, outTangent, inTangent) <= tolerance) {
+				good = middle;
+			}
+			else {
+				bad = middle;
+			}
+		}
+
+		//Refit the chosen segment, write its out-tangent into the previous key and add its end key
+		spline->maxError = std::max(spline->maxError, fitSplineSegment(samples.data(), a, good, width, rotation, outTangent, inTangent));
+		double seconds = (good - a) * frameSeconds;
+		float* previousOut = &spline->values[spline->values.size() - width];
+		for (int c = 0; c < width; c++) {
+			previousOut[c] = (float)(outTangent[c] / seconds);
+		}
+		addKey(good, inTangent, seconds);
+		a = good;
+	}
+}
@@ -0,0 +1,458 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "fbxFunctions.h"
+#include "gltfFunctions.h"
+#include "exportFunctions.h"
+#include "checkerFunctions.h"
+#include "profilerFunctions.h"
+#include "traceFunctions.h"
+#include "skeletonLogFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <experimental/filesystem>
+
+#define STREAMING_EXPORT_CHUNK_FRAMES 300
+#define STREAMING_EXPORT_MAX_PENDING_CHUNKS 8
+
+//Writes one output file from a session handed over a chunk at a time, in frame order. Every call returns an error
+//message, empty on success. abort() is called instead of finish() after a failure, or after finish() failed, and
+//removes whatever part of the output was already written.
+class SkeletonExporter {
+public:
+	virtual ~SkeletonExporter() {}
+	virtual std::string begin(const char* output_path, const k4a_calibration_t* calibration, int frameRate) = 0;
+	virtual std::string appendChunk(const SkeletonTrack& chunk) = 0;
+	virtual std::string finish() = 0;
+	virtual void abort() = 0;
+};
+
+//Removes a partly written output. The output did not exist when the export began, so anything there is ours.
+void removePartialOutput(const std::string& output_path) {
+	if (output_path != "" && fileExists(output_path.c_str())) {
+		std::remove(output_path.c_str());
+	}
+}
+
+//Adds the keys of every chunk to the scene's curves as it arrives, only the FBX scene itself grows with the session
+class FbxSkeletonExporter : public SkeletonExporter {
+public:
+	~FbxSkeletonExporter() {
+		release();
+	}
+
+	std::string begin(const char* output_path, const k4a_calibration_t* calibration, int frameRate) override {
+		m_path = output_path;
+		InitializeSdkManager(m_manager);
+		m_scene = FbxScene::Create(m_manager, "My Scene");
+		if (!m_scene) {
+			release();
+			return "Unable to create FBX scene.\n";
+		}
+		beginSkeletonAnimation(m_manager, m_scene, std::experimental::filesystem::path(m_path).stem().string(), &m_animation);
+		return "";
+	}
+
+	std::string appendChunk(const SkeletonTrack& chunk) override {
+		addSkeletonKeys(&m_animation, chunk);
+		return "";
+	}
+
+	std::string finish() override {
+		endSkeletonAnimation(&m_animation);
+		createMesh(m_scene);
+		bool success = SaveScene(m_manager, m_scene, m_path.c_str(), -1, false);
+		release();
+		return success ? "" : "An error occurred while creating the fbx.\n";
+	}
+
+	void abort() override {
+		release();
+		removePartialOutput(m_path);
+	}
+
+private:
+	void release() {
+		if (m_manager != NULL) {
+			DestroySdkObjects(m_manager, true);
+		}
+		m_manager = NULL;
+		m_scene = NULL;
+	}
+
+	std::string m_path = "";
+	FbxManager* m_manager = NULL;
+	FbxScene* m_scene = NULL;
+	FbxSkeletonAnimation m_animation;
+};
+
+//glTF wants each joint's channels contiguous, but frames arrive joint by joint within a chunk. Chunks are spilled
+//to a file next to the output as they arrive and transposed one joint at a time when the file is written, so
+//memory holds one chunk or one joint column rather than the whole session. Bounds are grown chunk by chunk, and
+//rigged exports convert each chunk to parent-relative poses before spilling its translations and then its rotations.
+class GltfSkeletonExporter : public SkeletonExporter {
+public:
+	GltfSkeletonExporter(const GltfExportOptions& options) : m_options(options) {}
+
+	~GltfSkeletonExporter() {
+		removeSpill();
+	}
+
+	std::string begin(const char* output_path, const k4a_calibration_t* calibration, int frameRate) override {
+		m_path = output_path;
+		m_spillPath = m_path + ".spill";
+		m_spill.open(m_spillPath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!m_spill.is_open()) {
+			return "Failed to create glTF spill file.\n";
+		}
+		m_chunkOffsets.clear();
+		m_chunkFrames.clear();
+		m_desc = GltfAnimationDesc();
+		applyGltfExportOptions(m_options, &m_desc);
+		m_poseBuilder = LocalPoseBuilder();
+		m_take = GltfTake();
+		m_frameCount = 0;
+		m_spillBytes = 0;
+		return "";
+	}
+
+	std::string appendChunk(const SkeletonTrack& chunk) override {
+		if (chunk.empty()) {
+			return "";
+		}
+		m_chunkOffsets.push_back(m_spillBytes);
+		m_chunkFrames.push_back(chunk.size());
+		if (m_desc.rigged) {
+			for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+				m_localTranslations[joint].clear();
+				m_localRotations[joint].clear();
+			}
+			m_poseBuilder.append(chunk, m_localTranslations, m_localRotations);
+		}
+		for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+			const std::vector<float>& translations = m_desc.rigged ? m_localTranslations[joint] : chunk.positions(joint);
+			spill(translations);
+			growJointBounds(translations.data(), chunk.size(), &m_take.bounds[joint]);
+		}
+		if (m_desc.rigged) {
+			for (int joint = 0; joint < SKELETON_JOINT_COUNT; joint++) {
+				spill(m_localRotations[joint]);
+			}
+		}
+		m_frameCount += chunk.size();
+		return m_spill.good() ? "" : "Failed to write glTF spill file.\n";
+	}
+
+	std::string finish() override {
+		//Gather each joint's slice of every chunk into one column per channel
+		bool readFailed = false;
+		m_spill.flush();
+		m_desc.bindPose = m_poseBuilder.bindPose();
+		m_take.name = std::experimental::filesystem::path(m_path).stem().string();
+		m_take.frameCount = m_frameCount;
+		m_take.loadChannels = [&](int joint) {
+			JointChannels channels;
+			readFailed = !readColumn(joint, 3, 0, &m_translationColumn) || readFailed;
+			channels.translations = &m_translationColumn;
+			if (m_desc.rigged) {
+				readFailed = !readColumn(joint, 4, 3, &m_rotationColumn) || readFailed;
+				channels.rotations = &m_rotationColumn;
+			}
+			return channels;
+		};
+		bool success = createGLTF(m_desc, std::vector<GltfTake>(1U, m_take), m_path.c_str());
+		m_take.loadChannels = JointChannelLoader();
+		removeSpill();
+		std::vector<float>().swap(m_translationColumn);
+		std::vector<float>().swap(m_rotationColumn);
+
+		if (readFailed) {
+			return "Failed to read glTF spill file.\n";
+		}
+		return success ? "" : "An error occurred while creating the gltf.\n";
+	}
+
+	void abort() override {
+		removeSpill();
+		removePartialOutput(m_path);
+	}
+
+private:
+	void spill(const std::vector<float>& values) {
+		m_spill.write((const char*)values.data(), static_cast<std::streamsize>(values.size() * sizeof(float)));
+		m_spillBytes += values.size() * sizeof(float);
+	}
+
+	//Reads one joint's channel of width floats per frame, which starts after every joint's channels of skip floats
+	//per frame within each chunk
+	bool readColumn(int joint, size_t width, size_t skip, std::vector<float>* column) {
+		column->resize(m_frameCount * width);
+		size_t frame = 0;
+		for (size_t c = 0; c < m_chunkOffsets.size(); c++) {
+			size_t bytes = m_chunkFrames[c] * width * sizeof(float);
+			uint64_t offset = m_chunkOffsets[c] + SKELETON_JOINT_COUNT * m_chunkFrames[c] * skip * sizeof(float) + joint * bytes;
+			m_spill.seekg((std::streamoff)offset, std::ios::beg);
+			m_spill.read((char*)&(*column)[frame * width], static_cast<std::streamsize>(bytes));
+			if (m_spill.fail()) {
+				return false;
+			}
+			frame += m_chunkFrames[c];
+		}
+		return true;
+	}
+
+	void removeSpill() {
+		if (m_spill.is_open()) {
+			m_spill.close();
+			std::remove(m_spillPath.c_str());
+		}
+	}
+
+	std::string m_path = "";
+	std::string m_spillPath = "";
+	std::fstream m_spill;
+	std::vector<uint64_t> m_chunkOffsets;
+	std::vector<size_t> m_chunkFrames;
+	std::vector<float> m_translationColumn;
+	std::vector<float> m_rotationColumn;
+	std::vector<float> m_localTranslations[SKELETON_JOINT_COUNT];
+	std::vector<float> m_localRotations[SKELETON_JOINT_COUNT];
+	LocalPoseBuilder m_poseBuilder;
+	GltfExportOptions m_options;
+	GltfAnimationDesc m_desc;
+	GltfTake m_take;
+	size_t m_frameCount = 0;
+	uint64_t m_spillBytes = 0;
+};
+
+//.skel records are written as they arrive by the skeleton log writer
+class SkelSkeletonExporter : public SkeletonExporter {
+public:
+	std::string begin(const char* output_path, const k4a_calibration_t* calibration, int frameRate) override {
+		m_path = output_path;
+		return m_log.open(output_path, calibration, frameRate) ? "" : "An error occurred while creating the skel.\n";
+	}
+
+	std::string appendChunk(const SkeletonTrack& chunk) override {
+		for (size_t i = 0; i < chunk.size(); i++) {
+			m_log.append(chunk.skeleton(i), chunk.timestamps()[i]);
+		}
+		return "";
+	}
+
+	std::string finish() override {
+		return m_log.close() ? "" : "An error occurred while creating the skel.\n";
+	}
+
+	//The frames written so far would read back as a whole recording, so they are removed rather than left behind
+	void abort() override {
+		m_log.close();
+		removePartialOutput(m_path);
+	}
+
+private:
+	SkeletonLogWriter m_log;
+	std::string m_path = "";
+};
+
+//Formats without an incremental writer collect the session and export it when finished. This is not streaming: a
+//.skelz session is held in memory as a whole track, about 0.8 KB per frame or 85 MB an hour at 30 fps, because the
+//codec header stores the frame count and the encoder checks the whole track against its precision before writing.
+class BufferedSkeletonExporter : public SkeletonExporter {
+public:
+	BufferedSkeletonExporter(const ExportOptions& options) : m_options(options) {}
+
+	std::string begin(const char* output_path, const k4a_calibration_t* calibration, int frameRate) override {
+		m_path = output_path;
+		m_hasCalibration = calibration != NULL;
+		if (m_hasCalibration) {
+			m_calibration = *calibration;
+		}
+		m_track.clear();
+		return "";
+	}
+
+	std::string appendChunk(const SkeletonTrack& chunk) override {
+		m_track.append(chunk);
+		return "";
+	}
+
+	std::string finish() override {
+		std::string errorMessage = exportSkeletons(m_track, m_path.c_str(), m_options, m_hasCalibration ? &m_calibration : NULL);
+		m_track.clear();
+		return errorMessage;
+	}
+
+	void abort() override {
+		m_track.clear();
+		removePartialOutput(m_path);
+	}
+
+private:
+	ExportOptions m_options;
+	std::string m_path = "";
+	SkeletonTrack m_track;
+	k4a_calibration_t m_calibration;
+	bool m_hasCalibration = false;
+};
+
+//Picks the exporter for the output extension, NULL if it is not a supported type
+std::unique_ptr<SkeletonExporter> createSkeletonExporter(const char* output_path, const ExportOptions& options) {
+	if (outputFBX(output_path)) {
+		return std::unique_ptr<SkeletonExporter>(new FbxSkeletonExporter());
+	}
+	if (outputGLTF(output_path) || outputGLB(output_path)) {
+		return std::unique_ptr<SkeletonExporter>(new GltfSkeletonExporter(options.gltf));
+	}
+	if (outputSKEL(output_path)) {
+		return std::unique_ptr<SkeletonExporter>(new SkelSkeletonExporter());
+	}
+	if (outputSKELZ(output_path)) {
+		return std::unique_ptr<SkeletonExporter>(new BufferedSkeletonExporter(options));
+	}
+	return nullptr;
+}
+
+//Exports skeletons while they are captured. Frames are collected into chunks on the capture thread and a background
+//thread hands full chunks to the exporter, so only the file is left to write when capture ends. At most
+//STREAMING_EXPORT_MAX_PENDING_CHUNKS chunks wait for the exporter; when it falls that far behind, append() blocks
+//until a chunk is taken, which holds back tracking so the capture source's overload policy sheds frames instead of
+//the queue growing without bound.
+class ChunkedExportWriter {
+public:
+	~ChunkedExportWriter() {
+		close();
+	}
+
+	//Returns an error message, empty on success
+	std::string open(const char* output_path, const k4a_calibration_t* calibration, int frameRate, const ExportOptions& options) {
+		m_exporter = createSkeletonExporter(output_path, options);
+		if (!m_exporter) {
+			return "Invalid output type. Use fbx, gltf, glb, skel or skelz.\n";
+		}
+		createOutputDirectory(output_path);
+		m_errorMessage = m_exporter->begin(output_path, calibration, frameRate);
+		if (m_errorMessage != "") {
+			m_exporter.reset();
+			return m_errorMessage;
+		}
+		m_closing = false;
+		m_chunk.reserve(STREAMING_EXPORT_CHUNK_FRAMES);
+		m_thread = std::thread(&ChunkedExportWriter::exportLoop, this);
+		return "";
+	}
+
+	//Called from the capture thread, only takes the lock when a chunk is full
+	void append(const k4abt_skeleton_t& skeleton, uint64_t timestampUsec) {
+		m_chunk.append(skeleton, timestampUsec);
+		if (m_chunk.size() >= STREAMING_EXPORT_CHUNK_FRAMES) {
+			submitChunk();
+		}
+	}
+
+	//Exports any remaining frames and writes the file unless writeFile is false, returns an error message, empty on
+	//success. Without a written file any partial output is removed.
+	std::string close(bool writeFile = true) {
+		if (!m_thread.joinable()) {
+			return m_errorMessage;
+		}
+		if (!m_chunk.empty()) {
+			submitChunk();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closing = true;
+		}
+		m_condition.notify_one();
+		m_thread.join();
+
+		if (writeFile && m_errorMessage == "") {
+			ScopedTimer exportTimer(STAGE_EXPORT);
+			m_errorMessage += m_exporter->finish();
+		}
+		if (!writeFile || m_errorMessage != "") {
+			m_exporter->abort();
+		}
+		m_exporter.reset();
+		if (m_blockedChunks > 0) {
+			std::cout << "Export fell behind, " << m_blockedChunks << " chunks waited " << m_blockedSeconds * 1000 << " ms for the exporter" << std::endl;
+		}
+		return m_errorMessage;
+	}
+
+private:
+	void submitChunk() {
+		SkeletonTrack next;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_pending.size() >= STREAMING_EXPORT_MAX_PENDING_CHUNKS) {
+				TraceScope waitTrace("export queue full");
+				auto waitStart = std::chrono::steady_clock::now();
+				m_spaceCondition.wait(lock, [this]() { return m_pending.size() < STREAMING_EXPORT_MAX_PENDING_CHUNKS; });
+				std::chrono::duration<double> waited = std::chrono::steady_clock::now() - waitStart;
+				m_blockedChunks++;
+				m_blockedSeconds += waited.count();
+			}
+			m_pending.push_back(std::move(m_chunk));
+			traceInstant("export chunk queued");
+			if (!m_freeChunks.empty()) {
+				next = std::move(m_freeChunks.back());
+				m_freeChunks.pop_back();
+			}
+		}
+		m_condition.notify_one();
+		next.clear();
+		m_chunk = std::move(next);
+	}
+
+	void exportLoop() {
+		setTraceThreadName("exporter");
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_condition.wait(lock, [this]() { return m_closing || !m_pending.empty(); });
+			if (m_pending.empty() && m_closing) {
+				break;
+			}
+			SkeletonTrack chunk = std::move(m_pending.front());
+			m_pending.pop_front();
+			m_spaceCondition.notify_one();
+
+			//Export outside the lock so the capture thread never waits on the exporter. After a failure the
+			//remaining chunks are only drained.
+			lock.unlock();
+			if (m_errorMessage == "") {
+				ScopedTimer exportTimer(STAGE_EXPORT);
+				m_errorMessage += m_exporter->appendChunk(chunk);
+			}
+			lock.lock();
+
+			m_freeChunks.push_back(std::move(chunk));
+		}
+	}
+
+	std::unique_ptr<SkeletonExporter> m_exporter;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::condition_variable m_spaceCondition;
+	SkeletonTrack m_chunk;
+	std::deque<SkeletonTrack> m_pending;
+	std::vector<SkeletonTrack> m_freeChunks;
+	bool m_closing = false;
+	size_t m_blockedChunks = 0;
+	double m_blockedSeconds = 0;
+	std::string m_errorMessage = "";	//Written by the export thread until it is joined
+};
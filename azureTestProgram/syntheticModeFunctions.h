@@ -0,0 +1,31 @@
+#pragma once
+
+#include <k4abt.h>
+
+#include "realtimeModeFunctions.h"
+#include "captureSourceFunctions.h"
+
+#include <string>
+#include <chrono>
+#include <iostream>
+
+//Runs the realtime recording pipeline on generated skeletons, so export and journal paths can be load tested without
+//a Kinect. journal=false disables the journal, so runs with and without it can be compared. The time each frame
+//spends in the journal on the capture thread is the journal append stage of the profile report.
+std::string syntheticModeFunction(const char* output_path, const ExportOptions& options, int frameCount = REALTIME_MAX_FRAMES, int fps = SYNTHETIC_DEFAULT_FPS,
+	bool paced = true, bool journal = true) {
+	if (frameCount < 1) {
+		return "Synthetic mode needs at least one frame.\n";
+	}
+
+	SyntheticSkeletonSource source((size_t)frameCount, fps, paced);
+	auto start = std::chrono::steady_clock::now();
+	std::string errorMessage = recordSkeletonSource(&source, output_path, options, NULL, journal);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (errorMessage == "") {
+		std::cout << "Recorded and exported " << frameCount << " synthetic frames in " << elapsed.count() << " s ("
+			<< (elapsed.count() > 0 ? frameCount / elapsed.count() : 0) << " frames/sec)" << std::endl;
+	}
+	return errorMessage;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "exportFunctions.h"
+#include "importFunctions.h"
+#include "checkerFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+//Writes several recorded skeleton files into one glTF document, one animation per take. Skeleton files are one take
+//named after the file, FBX and glTF inputs add every animation they hold. Every take animates the same joint nodes
+//and their channels share one buffer, so a player can switch between them.
+std::string takesModeFunction(const char* output_path, const std::vector<std::string>& input_paths, const GltfExportOptions& options) {
+	//Check output file existence
+	if (fileExists(output_path)) {
+		return "Output file already exists, please choose another name.\n";
+	}
+	if (!outputGLTF(output_path) && !outputGLB(output_path)) {
+		return "Invalid output type, takes are written to .gltf or .glb.\n";
+	}
+	if (input_paths.empty()) {
+		return "No takes given.\n";
+	}
+
+	std::vector<SkeletonTake> takes;
+	for (size_t i = 0; i < input_paths.size(); i++) {
+		size_t firstTake = takes.size();
+		std::string errorMessage = importSkeletons(input_paths[i].c_str(), &takes);
+		if (errorMessage != "") {
+			return input_paths[i] + ": " + errorMessage;
+		}
+		for (size_t t = firstTake; t < takes.size(); t++) {
+			std::cout << "Read take " << takes[t].name << " from " << input_paths[i] << ", " << takes[t].track.size() << " frames" << std::endl;
+		}
+	}
+
+	//Create GLTF with every take
+	std::vector<std::string> takeNames;
+	std::vector<const SkeletonTrack*> tracks;
+	for (size_t t = 0; t < takes.size(); t++) {
+		takeNames.push_back(takes[t].name);
+		tracks.push_back(&takes[t].track);
+	}
+	createOutputDirectory(output_path);
+	ScopedTimer exportTimer(STAGE_EXPORT);
+	if (!createGLTF(takeNames, tracks, output_path, options)) {
+		return "An error occurred while creating the gltf.\n";
+	}
+	return "";
+}
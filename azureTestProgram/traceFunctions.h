@@ -0,0 +1,213 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+
+#define TRACE_CHUNK_EVENTS 16384
+#define TRACE_MAX_CHUNKS 256
+
+//One timeline event. Names must be string literals or otherwise outlive the trace.
+struct TraceEvent {
+	const char* name;
+	char phase;				//'B' begin, 'E' end, 'X' complete, 'i' instant
+	uint64_t timestampNsec;
+	uint64_t durationNsec;	//Only used by complete events
+};
+
+//Events of one thread. Only the owning thread appends, so no locks are taken while recording. Chunks are
+//published before the count, so writeTrace can read a consistent prefix even while the thread is still running.
+struct TraceThreadBuffer {
+	uint32_t threadId = 0;
+	std::string threadName = "";
+	std::atomic<TraceEvent*> chunks[TRACE_MAX_CHUNKS];
+	std::atomic<size_t> count{ 0 };
+	std::atomic<size_t> droppedEvents{ 0 };
+
+	TraceThreadBuffer() {
+		for (int i = 0; i < TRACE_MAX_CHUNKS; i++) {
+			chunks[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~TraceThreadBuffer() {
+		for (int i = 0; i < TRACE_MAX_CHUNKS; i++) {
+			delete[] chunks[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	void append(const TraceEvent& event) {
+		size_t index = count.load(std::memory_order_relaxed);
+		size_t chunk = index / TRACE_CHUNK_EVENTS;
+		if (chunk >= TRACE_MAX_CHUNKS) {
+			droppedEvents.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		TraceEvent* events = chunks[chunk].load(std::memory_order_relaxed);
+		if (events == nullptr) {
+			events = new TraceEvent[TRACE_CHUNK_EVENTS];
+			chunks[chunk].store(events, std::memory_order_release);
+		}
+		events[index % TRACE_CHUNK_EVENTS] = event;
+		count.store(index + 1, std::memory_order_release);
+	}
+};
+
+std::atomic<bool> traceEnabled{ false };
+uint64_t traceStartNsec = 0;
+std::mutex traceRegistryMutex;
+std::vector<std::unique_ptr<TraceThreadBuffer>> traceRegistry;
+thread_local TraceThreadBuffer* traceThreadBuffer = nullptr;
+
+uint64_t traceNowNsec() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Registers the calling thread on its first event, later events never touch the registry
+TraceThreadBuffer* getTraceThreadBuffer() {
+	if (traceThreadBuffer == nullptr) {
+		std::lock_guard<std::mutex> lock(traceRegistryMutex);
+		traceRegistry.push_back(std::unique_ptr<TraceThreadBuffer>(new TraceThreadBuffer()));
+		traceThreadBuffer = traceRegistry.back().get();
+		traceThreadBuffer->threadId = (uint32_t)traceRegistry.size();
+	}
+	return traceThreadBuffer;
+}
+
+//Tracing is off until this is called, every trace call is then a single relaxed load
+void startTracing() {
+	traceStartNsec = traceNowNsec();
+	traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+bool tracingEnabled() {
+	return traceEnabled.load(std::memory_order_relaxed);
+}
+
+//Names the calling thread in the timeline
+void setTraceThreadName(const std::string& name) {
+	if (!tracingEnabled()) {
+		return;
+	}
+	TraceThreadBuffer* buffer = getTraceThreadBuffer();
+	std::lock_guard<std::mutex> lock(traceRegistryMutex);
+	buffer->threadName = name;
+}
+
+void recordTraceEvent(const char* name, char phase, uint64_t timestampNsec, uint64_t durationNsec) {
+	TraceEvent event;
+	event.name = name;
+	event.phase = phase;
+	event.timestampNsec = timestampNsec;
+	event.durationNsec = durationNsec;
+	getTraceThreadBuffer()->append(event);
+}
+
+void traceBegin(const char* name) {
+	if (tracingEnabled()) {
+		recordTraceEvent(name, 'B', traceNowNsec(), 0);
+	}
+}
+
+void traceEnd(const char* name) {
+	if (tracingEnabled()) {
+		recordTraceEvent(name, 'E', traceNowNsec(), 0);
+	}
+}
+
+void traceInstant(const char* name) {
+	if (tracingEnabled()) {
+		recordTraceEvent(name, 'i', traceNowNsec(), 0);
+	}
+}
+
+//Records an interval that was already measured, used by the profiler so every timed stage shows up in the trace
+void traceComplete(const char* name, uint64_t startNsec, uint64_t endNsec) {
+	if (tracingEnabled()) {
+		recordTraceEvent(name, 'X', startNsec, endNsec > startNsec ? endNsec - startNsec : 0);
+	}
+}
+
+//Begin and end events around the enclosing scope
+class TraceScope {
+public:
+	TraceScope(const char* name) : m_name(name), m_active(tracingEnabled()) {
+		if (m_active) {
+			recordTraceEvent(m_name, 'B', traceNowNsec(), 0);
+		}
+	}
+
+	~TraceScope() {
+		if (m_active) {
+			recordTraceEvent(m_name, 'E', traceNowNsec(), 0);
+		}
+	}
+
+private:
+	const char* m_name;
+	bool m_active;
+};
+
+void writeTraceString(std::ofstream& file, const std::string& text) {
+	file << '"';
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		if (c == '"' || c == '\\') {
+			file << '\\' << c;
+		}
+		else if ((unsigned char)c >= 0x20) {
+			file << c;
+		}
+	}
+	file << '"';
+}
+
+//Writes every recorded event in Chrome trace event format, open it in chrome://tracing or Perfetto.
+//Threads that are still running keep recording, only events published before the call are written.
+bool writeTrace(const std::string& path) {
+	std::ofstream file(path, std::ofstream::out | std::ofstream::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	std::lock_guard<std::mutex> lock(traceRegistryMutex);
+	bool first = true;
+	size_t droppedEvents = 0;
+	for (size_t t = 0; t < traceRegistry.size(); t++) {
+		const TraceThreadBuffer& buffer = *traceRegistry[t];
+		if (buffer.threadName != "") {
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.threadId << ",\"args\":{\"name\":";
+			writeTraceString(file, buffer.threadName);
+			file << "}}";
+			first = false;
+		}
+
+		size_t count = buffer.count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const TraceEvent& event = buffer.chunks[i / TRACE_CHUNK_EVENTS].load(std::memory_order_acquire)[i % TRACE_CHUNK_EVENTS];
+			uint64_t timestampNsec = event.timestampNsec > traceStartNsec ? event.timestampNsec - traceStartNsec : 0;
+			file << (first ? "" : ",\n") << "{\"name\":";
+			writeTraceString(file, event.name);
+			file << ",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer.threadId << ",\"ts\":" << timestampNsec / 1000.0;
+			if (event.phase == 'X') {
+				file << ",\"dur\":" << event.durationNsec / 1000.0;
+			}
+			else if (event.phase == 'i') {
+				file << ",\"s\":\"t\"";
+			}
+			file << "}";
+			first = false;
+		}
+		droppedEvents += buffer.droppedEvents.load(std::memory_order_relaxed);
+	}
+	file << "\n],\"otherData\":{\"droppedEvents\":" << droppedEvents << "}}\n";
+	return file.good();
+}
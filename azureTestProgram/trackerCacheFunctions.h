@@ -0,0 +1,136 @@
+#pragma once
+
+#include <k4abt.h>
+#include <k4abtversion.h>
+
+#include "checkerFunctions.h"
+#include "skelFileFunctions.h"
+#include "skeletonTrackFunctions.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <experimental/filesystem>
+
+#define TRACKER_CACHE_DEFAULT_DIR "skeletonCache"
+#define TRACKER_CACHE_SAMPLE_COUNT 16
+#define TRACKER_CACHE_SAMPLE_BYTES (64 * 1024)
+
+uint64_t fnv1aHash(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//Hashes the recording's absolute path, modification time, size and evenly spaced samples of its content. Reading a
+//few hundred KB instead of the whole multi-GB file keeps a cache lookup far cheaper than tracking. The risk is a
+//file edited in place that keeps its size and modification time and only differs outside the samples, which would
+//load the old skeletons: tools that restore timestamps can do that, so run with -nocache after such edits. Moving
+//or touching a recording only costs one more tracking pass. Returns false if the file cannot be read.
+bool hashRecording(const char* input_path, uint64_t* hash) {
+	std::ifstream file(input_path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return false;
+	}
+	uint64_t fileSize = (uint64_t)file.tellg();
+	uint64_t result = fnv1aHash(&fileSize, sizeof(fileSize));
+
+	std::error_code error;
+	std::string absolutePath = std::experimental::filesystem::absolute(input_path).string();
+	result = fnv1aHash(absolutePath.data(), absolutePath.size(), result);
+	int64_t modified = (int64_t)std::experimental::filesystem::last_write_time(input_path, error).time_since_epoch().count();
+	if (error) {
+		return false;
+	}
+	result = fnv1aHash(&modified, sizeof(modified), result);
+
+	std::vector<char> sample(TRACKER_CACHE_SAMPLE_BYTES);
+	for (int i = 0; i < TRACKER_CACHE_SAMPLE_COUNT; i++) {
+		uint64_t offset = fileSize > sample.size() ? (fileSize - sample.size()) / (TRACKER_CACHE_SAMPLE_COUNT - 1) * i : 0;
+		file.seekg((std::streamoff)offset, std::ios::beg);
+		file.read(sample.data(), (std::streamsize)sample.size());
+		std::streamsize readBytes = file.gcount();
+		file.clear();
+		result = fnv1aHash(sample.data(), (size_t)readBytes, result);
+	}
+	*hash = result;
+	return true;
+}
+
+//Persistent store of tracker output. Entries are .skel files named after the recording hash combined with
+//everything that changes the tracker's output: its configuration, the tracking mode, the body tracking SDK version
+//(its network model ships with it) and the file format version. Entries keep the recording's calibration.
+class TrackerCache {
+public:
+	TrackerCache(const std::string& directory = TRACKER_CACHE_DEFAULT_DIR) : m_directory(directory) {}
+
+	//Computes the cache key, returns false if the recording cannot be read
+	bool prepare(const char* input_path, const k4abt_tracker_configuration_t& trackerConfig, const std::string& trackingMode) {
+		uint64_t key;
+		if (!hashRecording(input_path, &key)) {
+			return false;
+		}
+		//Hash the fields rather than the struct so the key does not depend on its layout or padding
+		int32_t configFields[3] = { (int32_t)trackerConfig.sensor_orientation, (int32_t)trackerConfig.processing_mode, trackerConfig.gpu_device_id };
+		key = fnv1aHash(configFields, sizeof(configFields), key);
+		key = fnv1aHash(trackingMode.data(), trackingMode.size(), key);
+		const char* sdkVersion = K4ABT_VERSION_STR;
+		key = fnv1aHash(sdkVersion, std::strlen(sdkVersion), key);
+		uint32_t version = SKEL_VERSION;
+		key = fnv1aHash(&version, sizeof(version), key);
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.skel", (unsigned long long)key);
+		m_entryPath = (std::experimental::filesystem::path(m_directory) / name).string();
+		return true;
+	}
+
+	//Appends the cached skeletons to track and copies the stored calibration, haveCalibration is false for entries
+	//stored without one. Returns false on a miss.
+	bool load(SkeletonTrack* track, k4a_calibration_t* calibration, bool* haveCalibration) const {
+		if (m_entryPath == "" || !fileExists(m_entryPath.c_str())) {
+			return false;
+		}
+		SkelFileReader reader;
+		if (reader.open(m_entryPath) != "" || !reader.indexed()) {
+			return false;
+		}
+		reader.readAll(track);
+		*haveCalibration = reader.calibration() != NULL;
+		if (*haveCalibration) {
+			*calibration = *reader.calibration();
+		}
+		return true;
+	}
+
+	//Stores a finished track. Written under a temporary name and renamed, so a crash never leaves a partial entry.
+	bool store(const SkeletonTrack& track, const k4a_calibration_t* calibration) const {
+		if (m_entryPath == "") {
+			return false;
+		}
+		std::error_code error;
+		std::experimental::filesystem::create_directories(m_directory, error);
+		std::string temporaryPath = m_entryPath + ".tmp";
+		if (!writeSkelFile(track, temporaryPath.c_str(), calibration)) {
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+		std::remove(m_entryPath.c_str());
+		return std::rename(temporaryPath.c_str(), m_entryPath.c_str()) == 0;
+	}
+
+	const std::string& entryPath() const {
+		return m_entryPath;
+	}
+
+private:
+	std::string m_directory;
+	std::string m_entryPath = "";
+};
@@ -5,53 +5,42 @@
 #include <k4arecord/playback.h>
 #include <k4abt.h>
 
-#include "windows.h"
+#include "checkerFunctions.h"
+#include "captureSourceFunctions.h"
+#include "profilerFunctions.h"
+
 #include <iostream>
 #include <string>
 
 std::string videoModeFunction() {
 	std::string errorMessage = "";
-	uint32_t kinectCount = k4a_device_get_installed_count();
-
-	if (kinectCount == 1 && errorMessage == "") { //Run program if Kinect is found
-		//Connect to the Kinect
-		k4a_device_t device = NULL;
-		if (K4A_FAILED(k4a_device_open(K4A_DEVICE_DEFAULT, &device))) {
-			errorMessage += "Kinect was found by program, but can't connect. Please try reconnecting.\n";
-		}
 
-		//Initialize the Kinect
-		k4a_device_configuration_t device_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
-		device_config.camera_fps = K4A_FRAMES_PER_SECOND_5;
-		device_config.color_format = K4A_IMAGE_FORMAT_COLOR_MJPG;
-		device_config.color_resolution = K4A_COLOR_RESOLUTION_720P;
-		device_config.depth_mode = K4A_DEPTH_MODE_WFOV_2X2BINNED;
-		device_config.synchronized_images_only = true;
-		k4a_calibration_t sensor_calibration;
-		if (errorMessage == "" && K4A_FAILED(k4a_device_get_calibration(device, device_config.depth_mode, device_config.color_resolution, &sensor_calibration))) {
-			errorMessage += "Get depth camera calibration failed. \n";
-		}
+	//Initialize the Kinect
+	k4a_device_configuration_t device_config = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+	device_config.camera_fps = K4A_FRAMES_PER_SECOND_5;
+	device_config.color_format = K4A_IMAGE_FORMAT_COLOR_MJPG;
+	device_config.color_resolution = K4A_COLOR_RESOLUTION_720P;
+	device_config.depth_mode = K4A_DEPTH_MODE_WFOV_2X2BINNED;
+	device_config.synchronized_images_only = true;
+	DeviceCaptureSource device(device_config);
+	errorMessage += device.open();
+
+	if (errorMessage == "") { //Run program if Kinect is connected
 		k4a_transformation_t transformation_handle = NULL;
-		transformation_handle = k4a_transformation_create(&sensor_calibration);
+		transformation_handle = k4a_transformation_create(&device.calibration());
 
 		// Create body tracker
 		k4abt_tracker_t tracker = NULL;
 		k4abt_tracker_configuration_t tracker_config = K4ABT_TRACKER_CONFIG_DEFAULT;
-		if (errorMessage == "" && K4A_FAILED(k4abt_tracker_create(&sensor_calibration, tracker_config, &tracker))) {
+		if (errorMessage == "" && K4A_FAILED(k4abt_tracker_create(&device.calibration(), tracker_config, &tracker))) {
 			errorMessage += "Body tracker initialization failed. \n";
 		}
 
-		//Start recording
-		if (errorMessage == "" && K4A_FAILED(k4a_device_start_cameras(device, &device_config))) {
-			errorMessage += "Kinect camera failed to start, please try reconnecting.\n";
-			k4a_device_close(device);
-		}
-
 		//Create output path
 		std::experimental::filesystem::create_directory("export");
-		//CreateDirectory(path.parent_path().string().c_str(), NULL);
 
 		//Process Kinect recording data
+		setTraceThreadName("video");
 		int runTime = -1;
 		bool running = true;
 		while (running && errorMessage == "") {
@@ -59,13 +48,14 @@ std::string videoModeFunction() {
 			runTime++;
 
 			//Press spacebar to stop recording
-			if (GetAsyncKeyState(VK_SPACE)) {
+			if (stopKeyPressed()) {
 				running = false;
 			}
 
 			//Get current frame
 			k4a_capture_t sensor_capture;
-			k4a_wait_result_t get_capture_result = k4a_device_get_capture(device, &sensor_capture, K4A_WAIT_INFINITE);
+			bool endOfStream = false;
+			k4a_wait_result_t get_capture_result = device.getCapture(&sensor_capture, K4A_WAIT_INFINITE, &endOfStream);
 
 			//Process current frame
 			if (get_capture_result == K4A_WAIT_RESULT_SUCCEEDED) {
@@ -87,14 +77,21 @@ std::string videoModeFunction() {
 				}
 
 				// Check for skeletons
+				uint64_t enqueueStart = profileNowNsec();
 				k4a_wait_result_t queue_capture_result = k4abt_tracker_enqueue_capture(tracker, sensor_capture, K4A_WAIT_INFINITE);
 				if (queue_capture_result == K4A_WAIT_RESULT_FAILED) {
 					errorMessage += ("Add capture to tracker process queue failed.\n");
 				}
 				k4abt_frame_t body_frame = NULL;
+				uint64_t popStart = profileNowNsec();
 				k4a_wait_result_t pop_frame_result = k4abt_tracker_pop_result(tracker, &body_frame, K4A_WAIT_INFINITE);
 				if (pop_frame_result == K4A_WAIT_RESULT_SUCCEEDED && errorMessage == "") {
+					uint64_t popEnd = profileNowNsec();
+					recordProfileStage(STAGE_TRACKER_ENQUEUE, enqueueStart, popStart);
+					recordProfileStage(STAGE_TRACKER_POP, popStart, popEnd);
+					recordProfileStage(STAGE_TRACKER_LATENCY, enqueueStart, popEnd);
 					uint32_t num_bodies = k4abt_frame_get_num_bodies(body_frame);
+					TraceScope writeScope("write images");
 					if (num_bodies > 0) {
 						// Save depth image with body
 						std::string depthFileName = "C:\\Users\\Samuel Lally\\OneDrive - Virginia Tech\\Classes\\2021 Summer\\Iceland\\Processing\\researchProject\\data\\depthImageBody" + std::to_string(runTime) + ".txt";
@@ -138,19 +135,14 @@ std::string videoModeFunction() {
 			}
 		}
 
-		//Stop Kinect
+		//Stop tracker
 		k4abt_tracker_shutdown(tracker);
 		k4abt_tracker_destroy(tracker);
 		k4a_transformation_destroy(transformation_handle);
-		k4a_device_stop_cameras(device);
-		k4a_device_close(device);
-	}
-	else if (kinectCount == 0) { //End program if Kinect isn't found
-		errorMessage += "Kinect can't be found by program, please try reconnecting.\n";
-	}
-	else if (errorMessage == "") { //End program if multiple Kinects are found
-		errorMessage += "Multiple Kinects, detected. Please unplug additional ones.\n";
 	}
 
+	//Stop Kinect
+	device.close();
+
 	return errorMessage;
 }
\ No newline at end of file